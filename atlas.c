@@ -0,0 +1,226 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "atlas.h"
+#include "ffont.h"
+
+static const char ATLAS_MAGIC[8] = "iMONATL";
+#define ATLAS_FREETYPE ((FREETYPE_MAJOR << 16) | (FREETYPE_MINOR << 8) | FREETYPE_PATCH)
+
+ciMonAtlas::ciMonAtlas()
+{
+  map = NULL;
+  mapSize = 0;
+  header = NULL;
+  glyphs = NULL;
+  data = NULL;
+}
+
+ciMonAtlas::~ciMonAtlas()
+{
+  Unmap();
+}
+
+void ciMonAtlas::Unmap()
+{
+  if(map)
+    munmap(map, mapSize);
+  map = NULL;
+  mapSize = 0;
+  header = NULL;
+  glyphs = NULL;
+  data = NULL;
+}
+
+/**
+ * Map a atlas file, if it was written for this font and size.
+ * \param FileName   Path of atlas file.
+ * \param FontHash   Hash of font file, see HashFile().
+ * \param CharHeight Requested character height.
+ * \param Height     Height of font, as calculated by FreeType.
+ * \param Bottom     Bottom of font, as calculated by FreeType.
+ * \return false, if file missing, outdated or damaged.
+ */
+bool ciMonAtlas::Map(const char *FileName, uint64_t FontHash, int CharHeight, int Height, int Bottom)
+{
+  Unmap();
+
+  int fd = open(FileName, O_RDONLY);
+  if(fd < 0)
+    return false; // not yet written
+  struct stat st;
+  if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ciMonAtlasHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(p == MAP_FAILED) {
+    esyslog("iMonLCD: unable to map glyph atlas %s (%s)", FileName, strerror(errno));
+    return false;
+  }
+
+  const ciMonAtlasHeader *h = (const ciMonAtlasHeader *)p;
+  size_t size = st.st_size;
+  bool bOk = !memcmp(h->magic, ATLAS_MAGIC, sizeof(h->magic))
+          && h->version == ATLAS_VERSION
+          && h->freetype == ATLAS_FREETYPE
+          && h->fontHash == FontHash
+          && h->charHeight == CharHeight
+          && h->height == Height
+          && h->bottom == Bottom
+          && h->count <= ATLAS_MAX_GLYPHS
+          && size == sizeof(*h) + h->count * sizeof(ciMonAtlasGlyph) + h->dataSize;
+
+  // glyphs are searched by bisection, so they must be sorted
+  const ciMonAtlasGlyph *g = (const ciMonAtlasGlyph *)(h + 1);
+  for(uint32_t n = 0; bOk && n < h->count; ++n) {
+    bOk = g[n].offset <= h->dataSize
+       && g[n].size <= h->dataSize - g[n].offset
+       && g[n].width >= 0 && g[n].rows >= 0
+       && (n == 0 || g[n - 1].charCode < g[n].charCode);
+    int need = 0;
+    for(int shift = 0; bOk && shift < 8; ++shift)
+      need += g[n].width * ((g[n].rows + shift + 7) / 8);
+    bOk = bOk && (uint32_t)need == g[n].size;
+  }
+  if(!bOk) {
+    dsyslog("iMonLCD: ignore outdated glyph atlas %s", FileName);
+    munmap(p, size);
+    return false;
+  }
+
+  map = p;
+  mapSize = size;
+  header = h;
+  glyphs = g;
+  data = (const uchar *)(g + h->count);
+  return true;
+}
+
+const ciMonAtlasGlyph *ciMonAtlas::Find(uint CharCode) const
+{
+  int lo = 0;
+  int hi = Count() - 1;
+  while(lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if(glyphs[mid].charCode < CharCode)
+      lo = mid + 1;
+    else if(glyphs[mid].charCode > CharCode)
+      hi = mid - 1;
+    else
+      return glyphs + mid;
+  }
+  return NULL;
+}
+
+/**
+ * Write glyphs into a new atlas file. The file is replaced atomically,
+ * so a mapping of a previous version stays valid.
+ * \param Glyphs  Glyphs, sorted by their character code.
+ */
+bool ciMonAtlas::Write(const char *FileName, uint64_t FontHash, int CharHeight, int Height, int Bottom,
+                       const ciMonGlyph * const *Glyphs, int Count)
+{
+  ciMonAtlasHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, ATLAS_MAGIC, sizeof(h.magic));
+  h.version = ATLAS_VERSION;
+  h.freetype = ATLAS_FREETYPE;
+  h.fontHash = FontHash;
+  h.charHeight = CharHeight;
+  h.height = Height;
+  h.bottom = Bottom;
+  h.count = min(Count, ATLAS_MAX_GLYPHS);
+
+  ciMonAtlasGlyph *records = MALLOC(ciMonAtlasGlyph, h.count ? h.count : 1);
+  memset(records, 0, h.count * sizeof(ciMonAtlasGlyph));
+  for(uint32_t n = 0; n < h.count; ++n) {
+    const ciMonGlyph *g = Glyphs[n];
+    records[n].charCode = g->CharCode();
+    records[n].index = g->Index();
+    records[n].advanceX = g->AdvanceX();
+    records[n].advanceY = g->AdvanceY();
+    records[n].left = g->Left();
+    records[n].top = g->Top();
+    records[n].width = g->Width();
+    records[n].rows = g->Rows();
+    records[n].offset = h.dataSize;
+    records[n].size = g->Size();
+    h.dataSize += g->Size();
+  }
+
+  cString sTmp = cString::sprintf("%s.%d", FileName, getpid());
+  FILE *f = fopen(sTmp, "w");
+  if(!f) {
+    esyslog("iMonLCD: unable to write glyph atlas %s (%s)", *sTmp, strerror(errno));
+    free(records);
+    return false;
+  }
+  bool bOk = fwrite(&h, sizeof(h), 1, f) == 1
+          && fwrite(records, sizeof(ciMonAtlasGlyph), h.count, f) == h.count;
+  for(uint32_t n = 0; bOk && n < h.count; ++n)
+    bOk = fwrite(Glyphs[n]->Columns(0), 1, records[n].size, f) == records[n].size;
+  free(records);
+  if(fclose(f) != 0)
+    bOk = false;
+  if(bOk && rename(sTmp, FileName) < 0)
+    bOk = false;
+  if(!bOk) {
+    esyslog("iMonLCD: unable to write glyph atlas %s (%s)", FileName, strerror(errno));
+    unlink(sTmp);
+    return false;
+  }
+  dsyslog("iMonLCD: wrote glyph atlas %s with %u glyphs", FileName, h.count);
+  return true;
+}
+
+cString ciMonAtlas::FileName(const char *Directory, uint64_t FontHash, int CharHeight)
+{
+  return cString::sprintf("%s/atlas-%016llx-%d.bin", Directory, (unsigned long long)FontHash, CharHeight);
+}
+
+/// FNV-1a, continued from Hash
+static uint64_t Fnv1a(uint64_t Hash, const void *Data, size_t Size)
+{
+  const uchar *p = (const uchar *)Data;
+  for(size_t i = 0; i < Size; ++i) {
+    Hash ^= p[i];
+    Hash *= 0x100000001b3ULL;
+  }
+  return Hash;
+}
+
+/**
+ * Hash of name, size, time of last change and inode of a font file.
+ * The file isn't read, so a new or changed font gets a new atlas.
+ * \return 0, if the file doesn't exist.
+ */
+uint64_t ciMonAtlas::HashFile(const char *FileName)
+{
+  struct stat st;
+  if(stat(FileName, &st) < 0)
+    return 0;
+  uint64_t key[4] = { (uint64_t)st.st_size, (uint64_t)st.st_mtime,
+                      (uint64_t)st.st_ino, (uint64_t)st.st_dev };
+  uint64_t hash = Fnv1a(0xcbf29ce484222325ULL, FileName, strlen(FileName));
+  return Fnv1a(hash, key, sizeof(key));
+}
@@ -0,0 +1,82 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_ATLAS_H___
+#define __IMON_ATLAS_H___
+
+#include <stdint.h>
+#include <vdr/tools.h>
+
+class ciMonGlyph;
+
+#define ATLAS_VERSION    2     ///< increase on every change of the file layout
+#define ATLAS_MAX_GLYPHS 4096  ///< limit of glyphs stored for one font size
+
+struct ciMonAtlasHeader {
+  char     magic[8];   ///< "iMONATL"
+  uint32_t version;    ///< ATLAS_VERSION
+  uint32_t freetype;   ///< version of FreeType, which rendered the glyphs
+  uint64_t fontHash;   ///< hash of name, size, time and inode of the font file
+  int32_t  charHeight; ///< requested character height
+  int32_t  height;     ///< resulting font metrics
+  int32_t  bottom;
+  uint32_t count;      ///< number of glyph records
+  uint32_t dataSize;   ///< number of bytes of glyph bitmaps
+  uint32_t reserved;
+  };
+
+struct ciMonAtlasGlyph {
+  uint32_t charCode;   ///< records are sorted by this
+  uint32_t index;
+  int32_t  advanceX;
+  int32_t  advanceY;
+  int32_t  left;
+  int32_t  top;
+  int32_t  width;
+  int32_t  rows;
+  uint32_t offset;     ///< start of the bitmap, all 8 shifts in display layout
+  uint32_t size;
+  };
+
+/**
+ * Glyphs of one font size, stored in a file of the plugin's cache directory.
+ * The file is mapped read-only and shared, so glyphs which were rendered
+ * by an earlier run don't need FreeType and several instances of VDR
+ * share the same pages.
+ */
+class ciMonAtlas {
+private:
+  void *map;
+  size_t mapSize;
+  const ciMonAtlasHeader *header;
+  const ciMonAtlasGlyph *glyphs;
+  const uchar *data;
+public:
+  ciMonAtlas();
+  virtual ~ciMonAtlas();
+
+  bool Map(const char *FileName, uint64_t FontHash, int CharHeight, int Height, int Bottom);
+  void Unmap();
+  bool IsMapped() const { return header != NULL; }
+  int Count() const { return header ? header->count : 0; }
+  const ciMonAtlasGlyph *Glyph(int Index) const { return glyphs + Index; }
+  const ciMonAtlasGlyph *Find(uint CharCode) const;
+  const uchar *Data(const ciMonAtlasGlyph *Glyph) const { return data + Glyph->offset; }
+
+  static bool Write(const char *FileName, uint64_t FontHash, int CharHeight, int Height, int Bottom,
+                    const ciMonGlyph * const *Glyphs, int Count);
+  static cString FileName(const char *Directory, uint64_t FontHash, int CharHeight);
+  static uint64_t HashFile(const char *FileName);
+};
+
+#endif
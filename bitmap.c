@@ -21,16 +21,39 @@ ciMonBitmap::ciMonBitmap(int w, int h) {
   // lines are byte aligned
   bytesPerLine = (width + 7) / 8;
 
- 	bitmap = MALLOC(uchar, bytesPerLine * height);
+  capacity = bytesPerLine * height;
+ 	bitmap = MALLOC(uchar, capacity);
   clear();
 }
 
 ciMonBitmap::ciMonBitmap() {
   height = 0;
   width = 0;
+  capacity = 0;
   bitmap = NULL;
 }
 
+/**
+ * Change size and clear, memory is allocated only if the bitmap grows
+ * beyond the largest size before.
+ */
+bool ciMonBitmap::Resize(int w, int h) {
+  unsigned int size = ((w + 7) / 8) * h;
+  if(!bitmap || size > capacity) {
+    if(bitmap)
+      free(bitmap);
+    bitmap = MALLOC(uchar, size);
+    capacity = bitmap ? size : 0;
+    if(!bitmap)
+      return false;
+  }
+  width = w;
+  height = h;
+  bytesPerLine = (width + 7) / 8;
+  clear();
+  return true;
+}
+
 ciMonBitmap::~ciMonBitmap() {
 
   if(bitmap)  
@@ -53,8 +76,12 @@ ciMonBitmap& ciMonBitmap::operator = (const ciMonBitmap& x) {
 
     bytesPerLine = (width + 7) / 8;
 
-    if(height && width)
+    capacity = 0;
+    if(height && width) {
     	bitmap = MALLOC(uchar, bytesPerLine * height);
+      if(bitmap)
+        capacity = bytesPerLine * height;
+    }
   }
   if(x.bitmap)
   	memcpy(bitmap, x.bitmap, bytesPerLine * height);
@@ -77,6 +104,39 @@ void ciMonBitmap::clear() {
       memset(bitmap, 0x00, bytesPerLine * height);
 }
 
+/**
+ * Clear a rectangle, like a part of a line of text.
+ */
+void ciMonBitmap::clear(int x, int y, int w, int h) {
+    if (!bitmap)
+        return;
+    if (x < 0) {
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        h += y;
+        y = 0;
+    }
+    if (x + w > width)
+        w = width - x;
+    if (y + h > height)
+        h = height - y;
+    if (w <= 0 || h <= 0)
+        return;
+
+    unsigned int size = bytesPerLine * height;
+    for (int row = y / 8; row <= (y + h - 1) / 8; ++row) {
+        // bits of this row of bytes inside of the rectangle, top pixel is 0x80
+        int top = max(y - row * 8, 0);
+        int bottom = min(y + h - row * 8, 8);
+        uchar mask = (0xFF >> top) & (0xFF << (8 - bottom));
+        unsigned int n = x + (row * width);
+        for (int i = 0; i < w && n + i < size; ++i)
+            bitmap[n + i] &= ~mask;
+    }
+}
+
 bool ciMonBitmap::SetPixel(int x, int y)
 {
     unsigned char c;
@@ -100,3 +160,70 @@ bool ciMonBitmap::SetPixel(int x, int y)
     return true;
 }
 
+
+/**
+ * Copy a window of a wider bitmap with same height, like a scrolled strip.
+ * Both bitmaps store columns of 8 vertical pixels per byte, so each line
+ * of bytes is copied at once.
+ */
+void ciMonBitmap::Blit(const ciMonBitmap& src, int srcX)
+{
+    if (!bitmap || !src.bitmap || height != src.height)
+        return;
+
+    int x = 0;
+    int w = width;
+    if (srcX < 0) {
+        x = -srcX;
+        w -= x;
+        srcX = 0;
+    }
+    if (srcX + w > src.width)
+        w = src.width - srcX;
+    if (w <= 0)
+        return;
+
+    unsigned int size = bytesPerLine * height;
+    for (int row = 0; row < (height + 7) / 8; ++row) {
+        unsigned int n = x + (row * width);
+        if (n + w > size)
+            break;
+        memcpy(bitmap + n, src.bitmap + srcX + (row * src.width), w);
+    }
+}
+
+/**
+ * Combine a small bitmap in the same layout, like a glyph, into this bitmap.
+ * Clipping is done once, then whole bytes are or'd.
+ * \param x        Left column of the source.
+ * \param byteRow  Top row of bytes (8 vertical pixels) of the source.
+ * \param src      Source bitmap, w columns for each row of bytes.
+ * \param w        Width of the source.
+ * \param byteRows Count of byte rows of the source.
+ */
+void ciMonBitmap::OrColumns(int x, int byteRow, const uchar* src, int w, int byteRows)
+{
+    if (!bitmap || !src || width <= 0)
+        return;
+
+    int col0 = max(0, -x);
+    int col1 = min(w, width - x);
+    int row0 = max(0, -byteRow);
+    int row1 = min(byteRows, (height + 7) / 8 - byteRow);
+    if (col0 >= col1 || row0 >= row1)
+        return;
+
+    int size = bytesPerLine * height;
+    for (int row = row0; row < row1; ++row) {
+        uchar mask = 0xFF;
+        int y = (byteRow + row) * 8;
+        if (y + 8 > height) // don't set pixels below last line
+            mask = 0xFF << (y + 8 - height);
+        int n = x + (byteRow + row) * width;
+        int end = min(col1, size - n); // the last row of bytes can be cut by the allocated size
+        const uchar* s = src + row * w;
+        uchar* d = bitmap + n;
+        for (int col = col0; col < end; ++col)
+            d[col] |= s[col] & mask;
+    }
+}
@@ -18,6 +18,7 @@ class ciMonBitmap  {
   int height;
   int width;
   unsigned int bytesPerLine;
+  unsigned int capacity;  ///< allocated bytes, kept while the size shrinks
   uchar *bitmap;
 protected:
   ciMonBitmap();
@@ -28,10 +29,14 @@ public:
   ciMonBitmap& operator = (const ciMonBitmap& x);
   bool operator == (const ciMonBitmap& x) const;
 
+  bool Resize(int w, int h);
   void clear();
+  void clear(int x, int y, int w, int h);
   int Height() const { return height; }
   int Width() const { return width; }
   bool SetPixel(int x, int y);
+  void Blit(const ciMonBitmap& src, int srcX);
+  void OrColumns(int x, int byteRow, const uchar* src, int w, int byteRows);
 
   uchar * getBitmap() const { return bitmap; };
 };
@@ -0,0 +1,185 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include "encoder.h"
+
+/*
+ * Last byte of a packet selects the command, the other bytes are its data.
+ */
+#define CMD_SET_ICONS     0x01
+#define CMD_INIT          0x02  //not exactly sure what this does, but it's needed
+#define CMD_SET_CONTRAST  0x03
+#define CMD_SET_LINES0    0x10
+#define CMD_SET_LINES1    0x11
+#define CMD_SET_LINES2    0x12
+
+/* first byte of display commands, must be used with display byte of protocol */
+#define CMD_DISPLAY       0x00
+#define CMD_SHUTDOWN      0x08
+#define CMD_DISPLAY_ON    0x40
+#define CMD_CLOCK         0x80
+#define CMD_CLOCK_ALARM   0x24  // Works for me on 0038 (need check for ffdc)
+
+/*
+ * Display and alarm commands of 15c2:ffdc
+ */
+template<> struct ciMonProtocol<ePROTOCOL_FFDC> {
+  enum { DisplayByte = 0x50, AlarmByte = 0x51 };
+  static const char *Name() { return "ffdc"; }
+};
+
+/*
+ * Display and alarm commands of 15c2:0038
+ */
+template<> struct ciMonProtocol<ePROTOCOL_0038> {
+  enum { DisplayByte = 0x88, AlarmByte = 0x8a };
+  static const char *Name() { return "0038"; }
+};
+
+/**
+ * Encoder of one protocol, a new variant of the display needs only
+ * a specialization of ciMonProtocol.
+ */
+template<eProtocol P> class ciMonProtocolEncoder : public ciMonEncoder {
+private:
+  typedef ciMonProtocol<P> tProtocol;
+  static const ciMonPacket displayOn;
+  static const ciMonPacket shutdown;
+  static const ciMonPacket clearAlarm;
+public:
+  virtual const char *Name() const { return tProtocol::Name(); }
+  virtual const ciMonPacket& DisplayOn() const { return displayOn; }
+  virtual const ciMonPacket& Shutdown() const { return shutdown; }
+  virtual const ciMonPacket& ClearAlarm() const { return clearAlarm; }
+  virtual void Clock(const struct tm &Now, const struct tm *Alarm,
+                     ciMonPacket &Display, ciMonPacket &AlarmCmd) const;
+};
+
+template<eProtocol P> const ciMonPacket ciMonProtocolEncoder<P>::displayOn =
+  {{ CMD_DISPLAY_ON, 0, 0, 0, 0, 0, 0, ciMonProtocol<P>::DisplayByte }};
+template<eProtocol P> const ciMonPacket ciMonProtocolEncoder<P>::shutdown =
+  {{ CMD_SHUTDOWN, 0, 0, 0, 0, 0, 0, ciMonProtocol<P>::DisplayByte }};
+template<eProtocol P> const ciMonPacket ciMonProtocolEncoder<P>::clearAlarm =
+  {{ 0, 0, 0, 0, 0, 0, 0, ciMonProtocol<P>::AlarmByte }};
+
+/**
+ * Show the big clock, with alarm time if given.
+ */
+template<eProtocol P> void ciMonProtocolEncoder<P>::Clock(const struct tm &Now, const struct tm *Alarm,
+                                                         ciMonPacket &Display, ciMonPacket &AlarmCmd) const
+{
+  Display.data[0] = Alarm ? CMD_CLOCK_ALARM : CMD_CLOCK;
+  Display.data[1] = Now.tm_year;
+  Display.data[2] = Now.tm_mon;
+  Display.data[3] = Now.tm_mday;
+  Display.data[4] = Now.tm_hour;
+  Display.data[5] = Now.tm_min;
+  Display.data[6] = Now.tm_sec;
+  Display.data[7] = tProtocol::DisplayByte;
+
+  AlarmCmd = clearAlarm;
+  if(Alarm) {
+    AlarmCmd.data[0] = Alarm->tm_mon;
+    AlarmCmd.data[1] = Alarm->tm_mday;
+    AlarmCmd.data[2] = Alarm->tm_hour;
+    AlarmCmd.data[3] = Alarm->tm_min;
+  }
+}
+
+static const ciMonProtocolEncoder<ePROTOCOL_FFDC> encoderFFDC;
+static const ciMonProtocolEncoder<ePROTOCOL_0038> encoder0038;
+
+const ciMonEncoder *ciMonEncoder::Select(eProtocol Protocol)
+{
+  switch(Protocol) {
+    case ePROTOCOL_FFDC: return &encoderFFDC;
+    case ePROTOCOL_0038: return &encoder0038;
+  }
+  return NULL;
+}
+
+static const ciMonPacket packetInit       = {{ 0, 0, 0, 0, 0, 0, 0, CMD_INIT }};
+static const ciMonPacket packetClearIcons = {{ 0, 0, 0, 0, 0, 0, 0, CMD_SET_ICONS }};
+static const ciMonPacket packetClearLines[3] = {
+  {{ 0, 0, 0, 0, 0, 0, 0, CMD_SET_LINES0 }},
+  {{ 0, 0, 0, 0, 0, 0, 0, CMD_SET_LINES1 }},
+  {{ 0, 0, 0, 0, 0, 0, 0, CMD_SET_LINES2 }}
+};
+static const ciMonPacket packetContrast   = {{ 0x00, 0x0a, 0x58, 0x00, 0xff, 0xff, 0xff, CMD_SET_CONTRAST }};
+
+/// Store 7 bytes of data, least significant byte first, and the command byte
+static inline void Pack(uint64_t nData, uchar cCommand, ciMonPacket &p)
+{
+  for(int i = 0; i < IMON_PACKET_SIZE - 1; ++i)
+    p.data[i] = (uchar)(nData >> (i * 8));
+  p.data[IMON_PACKET_SIZE - 1] = cCommand;
+}
+
+const ciMonPacket& ciMonEncoder::Init()
+{
+  return packetInit;
+}
+
+const ciMonPacket& ciMonEncoder::ClearIcons()
+{
+  return packetClearIcons;
+}
+
+const ciMonPacket& ciMonEncoder::ClearLines(int n)
+{
+  return packetClearLines[n];
+}
+
+/**
+ * Set all icons around the display.
+ * \param Icons  Bits of icons, 7 bytes.
+ */
+void ciMonEncoder::Icons(uint64_t Icons, ciMonPacket &p)
+{
+  Pack(Icons, CMD_SET_ICONS, p);
+}
+
+/**
+ * Set contrast.
+ * \param Level  Hardware value, 0 (lowest) to 40 (highest).
+ */
+void ciMonEncoder::Contrast(int Level, ciMonPacket &p)
+{
+  p = packetContrast;
+  p.data[0] = (uchar)Level;
+}
+
+/**
+ * Set the built-in progress-bars and lines, least sig. bit is on the right.
+ * \param p  Three packets.
+ */
+void ciMonEncoder::Lines(int TopLine, int BotLine, int TopProgress, int BotProgress, ciMonPacket *p)
+{
+	uint64_t data0, data1, data2;
+
+	/* send bytes 1-4 of topLine and 1-3 of topProgress */
+	data0 = (uint64_t) TopLine & 0x00000000FFFFFFFFLL;
+	data0 |= (((uint64_t) TopProgress) << 8 * 4) & 0x00FFFFFF00000000LL;
+
+	/* send byte 4 of topProgress, bytes 1-4 of botProgress and 1-2 of botLine */
+	data1 = (((uint64_t) TopProgress) >> 8 * 3) & 0x00000000000000FFLL;
+	data1 |= (((uint64_t) BotProgress) << 8) & 0x000000FFFFFFFF00LL;
+	data1 |= (((uint64_t) BotLine) << 8 * 5) & 0x00FFFF0000000000LL;
+
+	/* send remaining bytes 3-4 of botLine */
+	data2 = ((uint64_t) BotLine) >> 8 * 2;
+
+  Pack(data0, CMD_SET_LINES0, p[0]);
+  Pack(data1, CMD_SET_LINES1, p[1]);
+  Pack(data2, CMD_SET_LINES2, p[2]);
+}
@@ -0,0 +1,67 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_ENCODER_H
+#define __IMON_ENCODER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <vdr/tools.h>
+
+#include "writer.h"
+
+enum eProtocol {
+  ePROTOCOL_FFDC   =   0,	/**< protocol ID for 15c2:ffdc device */
+  ePROTOCOL_0038   =   1	/**< protocol ID for 15c2:0038 device */
+};
+
+/**
+ * One command, in the byte order written to the device.
+ */
+struct ciMonPacket {
+  uchar data[IMON_PACKET_SIZE];
+};
+
+/**
+ * Command bytes, which differ between the variants of the display.
+ * Each variant is a specialization, see encoder.c.
+ */
+template<eProtocol P> struct ciMonProtocol;
+
+/**
+ * Build the packets of all commands. The fixed commands are tables, built
+ * by the compiler for each protocol. The encoder is selected once by
+ * ciMonLCD::open(), so building a command doesn't depend on the protocol.
+ */
+class ciMonEncoder {
+public:
+  virtual ~ciMonEncoder() {}
+
+  virtual const char *Name() const = 0;
+  virtual const ciMonPacket& DisplayOn() const = 0;
+  virtual const ciMonPacket& Shutdown() const = 0;
+  virtual const ciMonPacket& ClearAlarm() const = 0;
+  virtual void Clock(const struct tm &Now, const struct tm *Alarm,
+                     ciMonPacket &Display, ciMonPacket &AlarmCmd) const = 0;
+
+  static const ciMonEncoder *Select(eProtocol Protocol);
+
+  static const ciMonPacket& Init();
+  static const ciMonPacket& ClearIcons();
+  static const ciMonPacket& ClearLines(int n);
+  static void Icons(uint64_t Icons, ciMonPacket &p);
+  static void Contrast(int Level, ciMonPacket &p);
+  static void Lines(int TopLine, int BotLine, int TopProgress, int BotProgress, ciMonPacket *p);
+};
+
+#endif
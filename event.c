@@ -0,0 +1,111 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <string.h>
+
+#include "event.h"
+#include "stats.h"
+
+/**
+ * Copy text, a truncated text ends at a character boundary of UTF-8.
+ */
+void ciMonEvent::SetText(const char *sz)
+{
+  size_t n = sz ? strlen(sz) : 0;
+  if(n >= sizeof(text)) {
+    n = sizeof(text) - 1;
+    while(n > 0 && (sz[n] & 0xC0) == 0x80)
+      --n;
+  }
+  if(n)
+    memcpy(text, sz, n);
+  text[n] = '\0';
+}
+
+ciMonEventQueue::ciMonEventQueue()
+: m_nHead(0)
+, m_nTail(0)
+, m_bResync(0)
+{
+  for(unsigned int n = 0; n < EVENT_QUEUE_SIZE; ++n)
+    m_Events[n].sequence = n;
+}
+
+/**
+ * Append an event, called by status callbacks of any thread.
+ * \return false, if the queue was full and the event was dropped.
+ */
+bool ciMonEventQueue::Put(eEventType eType, int nValue, int nOption, const char *szText,
+                          const void *pSource)
+{
+  unsigned int nLimit = (eType >= eEventOsdText)
+                      ? EVENT_QUEUE_SIZE - EVENT_QUEUE_STATE : EVENT_QUEUE_SIZE;
+  unsigned int nHead = __atomic_load_n(&m_nHead, __ATOMIC_RELAXED);
+  ciMonEvent *e;
+  for(;;) {
+    e = &m_Events[nHead & (EVENT_QUEUE_SIZE - 1)];
+    int nDiff = (int)(__atomic_load_n(&e->sequence, __ATOMIC_ACQUIRE) - nHead);
+    if(nDiff > 0) {
+      // slot was reserved by another producer
+      nHead = __atomic_load_n(&m_nHead, __ATOMIC_RELAXED);
+      continue;
+    }
+    if(nDiff < 0 // slot isn't read yet
+       || nHead - __atomic_load_n(&m_nTail, __ATOMIC_ACQUIRE) >= nLimit) {
+      __atomic_store_n(&m_bResync, 1, __ATOMIC_RELEASE);
+      ciMonStats::Add(theStats.eventsDropped);
+      return false;
+    }
+    if(__atomic_compare_exchange_n(&m_nHead, &nHead, nHead + 1, true,
+                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      break;
+  }
+  e->type = eType;
+  e->value = nValue;
+  e->option = nOption;
+  e->source = pSource;
+  e->SetText(szText);
+  __atomic_store_n(&e->sequence, nHead + 1, __ATOMIC_RELEASE);
+  ciMonStats::Add(theStats.events);
+  return true;
+}
+
+/**
+ * Take the oldest event, called only by the watch thread.
+ * \return false, if the queue is empty, or the oldest event isn't filled yet.
+ */
+bool ciMonEventQueue::Get(ciMonEvent& e)
+{
+  unsigned int nTail = m_nTail;
+  const ciMonEvent& s = m_Events[nTail & (EVENT_QUEUE_SIZE - 1)];
+  if(__atomic_load_n(&s.sequence, __ATOMIC_ACQUIRE) != nTail + 1)
+    return false;
+  e.type = s.type;
+  e.value = s.value;
+  e.option = s.option;
+  e.source = s.source;
+  memcpy(e.text, s.text, strlen(s.text) + 1);
+  __atomic_store_n(&m_Events[nTail & (EVENT_QUEUE_SIZE - 1)].sequence,
+                   nTail + EVENT_QUEUE_SIZE, __ATOMIC_RELEASE);
+  __atomic_store_n(&m_nTail, nTail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/**
+ * Ask, if events were dropped since last call, called only by the watch thread.
+ * \return true, if the state must be read again from VDR.
+ */
+bool ciMonEventQueue::Resync()
+{
+  return __atomic_exchange_n(&m_bResync, 0, __ATOMIC_ACQ_REL) != 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_EVENT_H
+#define __IMON_EVENT_H
+
+#include <vdr/thread.h>
+
+#define EVENT_QUEUE_SIZE 128  ///< slots of event queue, must be a power of two
+#define EVENT_QUEUE_STATE 32  ///< slots, which only changes of state may use
+#define EVENT_TEXT_SIZE  256  ///< longer texts are truncated
+
+enum eEventType {
+  eEventReplaying,    ///< value: replay started (1) or stopped (0), text: name, source: control
+  eEventRecording,    ///< value: card index, option: started (1) or stopped (0)
+  eEventChannel,      ///< value: channel number
+  eEventVolume,       ///< value: volume, option: absolute (1) or relative (0)
+  eEventAudioTrack,   ///< value: track type, option: audio channel
+  eEventOsdClear,
+  eEventOsdText,      ///< first event with text of OSD, which may be dropped
+  eEventOsdTitle = eEventOsdText, ///< text: title, empty if none
+  eEventOsdItem,      ///< text: current item, empty if none
+  eEventOsdMessage    ///< text: status message, empty if none
+};
+
+struct ciMonEvent {
+  volatile unsigned int sequence; ///< slot is free for producer at index, filled at index + 1
+  eEventType type;
+  int        value;
+  int        option;
+  const void *source; ///< identity of sender, never dereferenced
+  char       text[EVENT_TEXT_SIZE];
+
+  void SetText(const char *sz);
+};
+
+/**
+ * Ring of events from status callbacks to the watch thread, without locks.
+ * Producers reserve a slot by compare-and-swap of the head, the sequence of
+ * each slot tells, whether it's free or filled. So the callback never waits
+ * on the display or on other callbacks.
+ *
+ * Texts of OSD may fill the ring only up to the last EVENT_QUEUE_STATE slots,
+ * which are kept for changes of state. If any event is dropped, the watch
+ * thread is asked for a full resync of its state.
+ */
+class ciMonEventQueue {
+private:
+  ciMonEvent m_Events[EVENT_QUEUE_SIZE];
+  volatile unsigned int m_nHead;  ///< next slot to reserve, written by producers
+  volatile unsigned int m_nTail;  ///< next slot to read, written by consumer
+  volatile int m_bResync;         ///< events were dropped since last Resync()
+public:
+  ciMonEventQueue();
+  bool Put(eEventType eType, int nValue = 0, int nOption = 0, const char *szText = NULL,
+           const void *pSource = NULL);
+  bool Get(ciMonEvent& e);
+  bool Resync();
+};
+
+#endif
@@ -14,118 +14,261 @@
 
 #include <vdr/tools.h>
 #include "ffont.h"
+#include "stats.h"
 
 // --- ciMonFont ---------------------------------------------------------
 
-#define KERNING_UNKNOWN  (-10000)
+#define KERNING_TABLE_MIN  256   ///< initial count of kerning pairs, power of two
+#define KERNING_TABLE_MAX  16384 ///< limit of kerning pairs, power of two
 
-ciMonGlyph::ciMonGlyph(uint CharCode, FT_GlyphSlotRec_ *GlyphData)
+ciMonGlyph::ciMonGlyph(uint CharCode, uint Index, FT_GlyphSlotRec_ *GlyphData)
 {
   charCode = CharCode;
+  index = Index;
   advanceX = GlyphData->advance.x >> 6;
   advanceY = GlyphData->advance.y >> 6;
   left = GlyphData->bitmap_left;
   top = GlyphData->bitmap_top;
   width = GlyphData->bitmap.width;
   rows = GlyphData->bitmap.rows;
-  pitch = GlyphData->bitmap.pitch;
-  bitmap = MALLOC(uchar, rows * pitch);
-  memcpy(bitmap, GlyphData->bitmap.buffer, rows * pitch);
-}
 
-ciMonGlyph::~ciMonGlyph()
-{
-  free(bitmap);
+  // convert the monochrome rows into columns of the display layout,
+  // for each possible vertical position within a byte
+  size = 0;
+  for (int shift = 0; shift < 8; shift++) {
+      offset[shift] = size;
+      size += width * ColumnRows(shift);
+      }
+  columns = MALLOC(uchar, size ? size : 1);
+  memset(columns, 0, size);
+  owned = true;
+
+  int pitch = GlyphData->bitmap.pitch;
+  const uchar *buffer = GlyphData->bitmap.buffer;
+  for (int row = 0; row < rows; row++) {
+      for (int col = 0; col < width; col++) {
+          if (buffer[row * pitch + col / 8] & (0x80 >> (col % 8))) {
+             for (int shift = 0; shift < 8; shift++) {
+                 int y = row + shift;
+                 columns[offset[shift] + (y / 8) * width + col] |= 0x80 >> (y % 8);
+                 }
+             }
+          }
+      }
 }
 
-int ciMonGlyph::GeciMonKerningCache(uint PrevSym) const
+ciMonGlyph::ciMonGlyph(const ciMonAtlasGlyph *Record, const uchar *Columns)
 {
-  for (int i = kerningCache.Size(); --i > 0; ) {
-      if (kerningCache[i].prevSym == PrevSym)
-         return kerningCache[i].kerning;
+  charCode = Record->charCode;
+  index = Record->index;
+  advanceX = Record->advanceX;
+  advanceY = Record->advanceY;
+  left = Record->left;
+  top = Record->top;
+  width = Record->width;
+  rows = Record->rows;
+  size = 0;
+  for (int shift = 0; shift < 8; shift++) {
+      offset[shift] = size;
+      size += width * ColumnRows(shift);
       }
-  return KERNING_UNKNOWN;
+  columns = (uchar *)Columns;
+  owned = false;
 }
 
-void ciMonGlyph::SeciMonKerningCache(uint PrevSym, int Kerning)
+ciMonGlyph::~ciMonGlyph()
 {
-  kerningCache.Append(ciMonKerning(PrevSym, Kerning));
+  if (owned)
+     free(columns);
 }
 
 
 
-ciMonFont::ciMonFont(const char *Name, int CharHeight, int CharWidth)
+ciMonFont::ciMonFont(FT_Face Face, const char *Name, int CharHeight, int CharWidth)
+: glyphHash(GLYPH_CACHE_SIZE)
 {
+  memset(glyphDirect, 0, sizeof(glyphDirect));
+  glyphHits = 0;
+  glyphMisses = 0;
+  kerningTable = NULL;
+  kerningSize = 0;
+  kerningCount = 0;
   height = 0;
   bottom = 0;
   width = CharWidth;
-  int error = FT_Init_FreeType(&library);
+  face = Face;
+  size = NULL;
+  fontHash = 0;
+  charHeight = CharHeight;
+  glyphsRendered = 0;
+  // caller must hold the mutex of theFontManager
+  int error = FT_New_Size(face, &size);
+  if (!error)
+     error = FT_Activate_Size(size);
   if (!error) {
-     error = FT_New_Face(library, Name, 0, &face);
-     if (!error) {
-        if (face->num_fixed_sizes && face->available_sizes) { // fixed font
-           // TODO what exactly does all this mean?
-           height = face->available_sizes->height;
-           for (uint sym ='A'; sym < 'z'; sym++) { // search for descender for fixed font FIXME
-               FT_UInt glyph_index = FT_Get_Char_Index(face, sym);
-               error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
+     if (face->num_fixed_sizes && face->available_sizes) { // fixed font
+        // TODO what exactly does all this mean?
+        height = face->available_sizes->height;
+        for (uint sym ='A'; sym < 'z'; sym++) { // search for descender for fixed font FIXME
+            FT_UInt glyph_index = FT_Get_Char_Index(face, sym);
+            error = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
+            if (!error) {
+               error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
                if (!error) {
-                  error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
-                  if (!error) {
-                     if (face->glyph->bitmap.rows-face->glyph->bitmap_top > bottom)
-                        bottom = face->glyph->bitmap.rows-face->glyph->bitmap_top;
-                     }
-                  else
-                     esyslog("iMonLCD: FreeType: error %d in FT_Render_Glyph", error);
+                  if (face->glyph->bitmap.rows-face->glyph->bitmap_top > bottom)
+                     bottom = face->glyph->bitmap.rows-face->glyph->bitmap_top;
                   }
                else
-                  esyslog("iMonLCD: FreeType: error %d in FT_Load_Glyph", error);
+                  esyslog("iMonLCD: FreeType: error %d in FT_Render_Glyph", error);
                }
+            else
+               esyslog("iMonLCD: FreeType: error %d in FT_Load_Glyph", error);
+            }
+        }
+     else {
+        error = FT_Set_Char_Size(face, // handle to face object
+                                 CharWidth  << 6, // CharWidth in 1/64th of points
+                                 CharHeight << 6, // CharHeight in 1/64th of points
+                                 CharWidth > 8 ? 64 : 80,    // horizontal device resolution
+                                 72);   // vertical device resolution
+        if (!error) {
+           height = ((face->size->metrics.ascender-face->size->metrics.descender) + 63) / 64;
+           bottom = abs((face->size->metrics.descender - 63) / 64);
            }
-        else {
-           error = FT_Set_Char_Size(face, // handle to face object
-                                    CharWidth  << 6, // CharWidth in 1/64th of points
-                                    CharHeight << 6, // CharHeight in 1/64th of points
-                                    CharWidth > 8 ? 64 : 80,    // horizontal device resolution
-                                    72);   // vertical device resolution
-           if (!error) {
-              height = ((face->size->metrics.ascender-face->size->metrics.descender) + 63) / 64;
-              bottom = abs((face->size->metrics.descender - 63) / 64);
-              }
-           else
-              esyslog("iMonLCD: FreeType: error %d during FT_Set_Char_Size (font = %s)\n", error, Name);
-           }
+        else
+           esyslog("iMonLCD: FreeType: error %d during FT_Set_Char_Size (font = %s)\n", error, Name);
         }
-     else
-        esyslog("iMonLCD: FreeType: load error %d (font = %s)", error, Name);
      }
   else
-     esyslog("iMonLCD: FreeType: initialization error %d (font = %s)", error, Name);
+     esyslog("iMonLCD: FreeType: error %d during FT_New_Size (font = %s)", error, Name);
 }
 
 ciMonFont::~ciMonFont()
 {
-  FT_Done_Face(face);
-  FT_Done_FreeType(library);
+  glyphHash.Clear();
+  glyphCacheMonochrome.Clear();
+  for (int i = 0; i < GLYPH_DIRECT_SIZE; i++)
+      delete glyphDirect[i];
+  free(kerningTable);
+  // caller must hold the mutex of theFontManager
+  if (size)
+     FT_Done_Size(size);
 }
 
-int ciMonFont::Kerning(ciMonGlyph *Glyph, uint PrevSym) const
+void ciMonFont::UseAtlas(const char *FileName, uint64_t FontHash)
 {
-  int kerning = 0;
-  if (Glyph && PrevSym) {
-     kerning = Glyph->GeciMonKerningCache(PrevSym);
-     if (kerning == KERNING_UNKNOWN) {
-        FT_Vector delta;
-        FT_UInt glyph_index = FT_Get_Char_Index(face, Glyph->CharCode());
-        FT_UInt glyph_index_prev = FT_Get_Char_Index(face, PrevSym);
-        FT_Get_Kerning(face, glyph_index_prev, glyph_index, FT_KERNING_DEFAULT, &delta);
-        kerning = delta.x / 64;
-        Glyph->SeciMonKerningCache(PrevSym, kerning);
-        }
+  atlasFile = FileName;
+  fontHash = FontHash;
+  if (atlas.Map(FileName, FontHash, charHeight, height, bottom))
+     dsyslog("iMonLCD: using glyph atlas %s with %d glyphs", FileName, atlas.Count());
+}
+
+static int CompareGlyphs(const void *a, const void *b)
+{
+  uint ca = (*(const ciMonGlyph **)a)->CharCode();
+  uint cb = (*(const ciMonGlyph **)b)->CharCode();
+  return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+/**
+ * Store all known glyphs into the atlas file, if FreeType has rendered new ones.
+ */
+void ciMonFont::SaveAtlas(void) const
+{
+  if (!glyphsRendered || isempty(atlasFile))
+     return;
+
+  // glyphs of the atlas, which are not cached, are wrapped temporarily
+  int n = 0;
+  int max = GLYPH_DIRECT_SIZE + glyphCacheMonochrome.Count() + atlas.Count();
+  const ciMonGlyph **glyphs = MALLOC(const ciMonGlyph *, max);
+  ciMonGlyph **wrapped = MALLOC(ciMonGlyph *, atlas.Count() ? atlas.Count() : 1);
+  int nWrapped = 0;
+  for (int i = 0; i < GLYPH_DIRECT_SIZE; i++) {
+      if (glyphDirect[i])
+         glyphs[n++] = glyphDirect[i];
+      }
+  for (const ciMonGlyph *g = glyphCacheMonochrome.First(); g; g = glyphCacheMonochrome.Next(g))
+      glyphs[n++] = g;
+  for (int i = 0; i < atlas.Count(); i++) {
+      const ciMonAtlasGlyph *a = atlas.Glyph(i);
+      if ((a->charCode < GLYPH_DIRECT_SIZE && glyphDirect[a->charCode])
+          || (a->charCode >= GLYPH_DIRECT_SIZE && glyphHash.Get(a->charCode)))
+         continue;
+      wrapped[nWrapped] = new ciMonGlyph(a, atlas.Data(a));
+      glyphs[n++] = wrapped[nWrapped++];
+      }
+  qsort(glyphs, n, sizeof(glyphs[0]), CompareGlyphs);
+
+  if (ciMonAtlas::Write(atlasFile, fontHash, charHeight, height, bottom, glyphs, n))
+     glyphsRendered = 0;
+
+  for (int i = 0; i < nWrapped; i++)
+      delete wrapped[i];
+  free(wrapped);
+  free(glyphs);
+}
+
+static inline uint KerningHash(uint PrevIndex, uint Index)
+{
+  return (PrevIndex * 0x9E3779B1u) ^ Index;
+}
+
+int ciMonFont::Kerning(ciMonGlyph *Glyph, uint PrevIndex) const
+{
+  if (!Glyph || !PrevIndex || !FT_HAS_KERNING(face))
+     return 0;
+
+  uint index = Glyph->Index();
+  if (kerningTable) {
+     uint mask = kerningSize - 1;
+     for (uint h = KerningHash(PrevIndex, index) & mask; kerningTable[h].prevIndex; h = (h + 1) & mask) {
+         if (kerningTable[h].prevIndex == PrevIndex && kerningTable[h].index == index)
+            return kerningTable[h].kerning;
+         }
      }
+
+  FT_Vector delta;
+  theFontManager.Mutex()->Lock();
+  FT_Activate_Size(size);
+  FT_Get_Kerning(face, PrevIndex, index, FT_KERNING_DEFAULT, &delta);
+  theFontManager.Mutex()->Unlock();
+  int kerning = delta.x / 64;
+  AddKerning(PrevIndex, index, kerning);
   return kerning;
 }
 
+void ciMonFont::AddKerning(uint PrevIndex, uint Index, int Kerning) const
+{
+  // keep the table at most half filled
+  if (!kerningTable || (kerningCount + 1) * 2 > kerningSize) {
+     ciMonKerning *old = kerningTable;
+     int oldSize = kerningSize;
+     if (!kerningTable)
+        kerningSize = KERNING_TABLE_MIN;
+     else if (kerningSize < KERNING_TABLE_MAX)
+        kerningSize *= 2;
+     else
+        oldSize = 0; // limit reached, start again with empty table
+     kerningTable = (ciMonKerning *)calloc(kerningSize, sizeof(ciMonKerning));
+     kerningCount = 0;
+     for (int i = 0; i < oldSize; i++) {
+         if (old[i].prevIndex)
+            AddKerning(old[i].prevIndex, old[i].index, old[i].kerning);
+         }
+     free(old);
+     }
+
+  uint mask = kerningSize - 1;
+  uint h = KerningHash(PrevIndex, Index) & mask;
+  while (kerningTable[h].prevIndex)
+        h = (h + 1) & mask;
+  kerningTable[h].prevIndex = PrevIndex;
+  kerningTable[h].index = Index;
+  kerningTable[h].kerning = Kerning;
+  ++kerningCount;
+}
+
 ciMonGlyph* ciMonFont::Glyph(uint CharCode) const
 {
   // Non-breaking space:
@@ -133,12 +276,62 @@ ciMonGlyph* ciMonFont::Glyph(uint CharCode) const
      CharCode = 0x20;
 
   // Lookup in cache:
-  cList<ciMonGlyph> *glyphCache = &glyphCacheMonochrome;
-  for (ciMonGlyph *g = glyphCache->First(); g; g = glyphCache->Next(g)) {
-      if (g->CharCode() == CharCode)
-         return g;
-      }
+  ciMonGlyph *g;
+  if (CharCode < GLYPH_DIRECT_SIZE) {
+     g = glyphDirect[CharCode];
+     if (g) {
+        ++glyphHits;
+        ciMonStats::Add(theStats.glyphHits);
+        return g;
+        }
+     ++glyphMisses;
+     ciMonStats::Add(theStats.glyphMisses);
+     g = LoadGlyph(CharCode);
+     if (g)
+        glyphDirect[CharCode] = g;
+     }
+  else {
+     g = glyphHash.Get(CharCode);
+     if (g) {
+        ++glyphHits;
+        ciMonStats::Add(theStats.glyphHits);
+        if (g != glyphCacheMonochrome.First()) { // most recently used glyph at first
+           glyphCacheMonochrome.Del(g, false);
+           glyphCacheMonochrome.Ins(g);
+           }
+        return g;
+        }
+     ++glyphMisses;
+     ciMonStats::Add(theStats.glyphMisses);
+     g = LoadGlyph(CharCode);
+     if (g) {
+        if (glyphCacheMonochrome.Count() >= GLYPH_CACHE_SIZE) { // drop least recently used glyph
+           ciMonGlyph *last = glyphCacheMonochrome.Last();
+           glyphHash.Del(last, last->CharCode());
+           glyphCacheMonochrome.Del(last);
+           }
+        glyphCacheMonochrome.Ins(g);
+        glyphHash.Add(g, CharCode);
+        }
+     }
+  if (g)
+     return g;
+#define UNKNOWN_GLYPH_INDICATOR '?'
+  if (CharCode != UNKNOWN_GLYPH_INDICATOR)
+     return Glyph(UNKNOWN_GLYPH_INDICATOR);
+  return NULL;
+}
+
+ciMonGlyph* ciMonFont::LoadGlyph(uint CharCode) const
+{
+  // prefer the glyph rendered by an earlier run
+  const ciMonAtlasGlyph *a = atlas.Find(CharCode);
+  if (a)
+     return new ciMonGlyph(a, atlas.Data(a));
 
+  // the face is shared with other sizes and threads
+  cMutexLock lock(theFontManager.Mutex());
+  FT_Activate_Size(size);
   FT_UInt glyph_index = FT_Get_Char_Index(face, CharCode);
 
   // Load glyph image into the slot (erase previous one):
@@ -156,14 +349,10 @@ ciMonGlyph* ciMonFont::Glyph(uint CharCode) const
      if (error)
         esyslog("iMonLCD: FreeType: error during FT_Render_Glyph %d, %d\n", CharCode, glyph_index);
      else { //new bitmap
-        ciMonGlyph *Glyph = new ciMonGlyph(CharCode, face->glyph);
-        glyphCache->Add(Glyph);
-        return Glyph;
+        ++glyphsRendered;
+        return new ciMonGlyph(CharCode, glyph_index, face->glyph);
         }
      }
-#define UNKNOWN_GLYPH_INDICATOR '?'
-  if (CharCode != UNKNOWN_GLYPH_INDICATOR)
-     return Glyph(UNKNOWN_GLYPH_INDICATOR);
   return NULL;
 }
 
@@ -177,15 +366,50 @@ int ciMonFont::Width(const char *s) const
 {
   int w = 0;
   if (s) {
-     uint prevSym = 0;
+     uint prevIndex = 0;
      while (*s) {
            int sl = Utf8CharLen(s);
            uint sym = Utf8CharGet(s, sl);
            s += sl;
            ciMonGlyph *g = Glyph(sym);
-           if (g)
-              w += g->AdvanceX() + Kerning(g, prevSym);
-           prevSym = sym;
+           if (g) {
+              w += g->AdvanceX() + Kerning(g, prevIndex);
+              prevIndex = g->Index();
+              }
+           else
+              prevIndex = 0;
+           }
+     }
+  return w;
+}
+
+/**
+ * Position of the character after the first bytes of a text, as it's drawn
+ * by DrawText(). This includes the kerning against the previous character,
+ * so drawing the rest of text at this position gives the same result.
+ */
+int ciMonFont::PrefixWidth(const char *s, int Bytes) const
+{
+  int w = 0;
+  if (s) {
+     uint prevIndex = 0;
+     const char *e = s + Bytes;
+     while (*s) {
+           int sl = Utf8CharLen(s);
+           uint sym = Utf8CharGet(s, sl);
+           ciMonGlyph *g = Glyph(sym);
+           if (s >= e) {
+              if (g)
+                 w += Kerning(g, prevIndex);
+              break;
+              }
+           s += sl;
+           if (g) {
+              w += g->AdvanceX() + Kerning(g, prevIndex);
+              prevIndex = g->Index();
+              }
+           else
+              prevIndex = 0;
            }
      }
   return w;
@@ -194,7 +418,7 @@ int ciMonFont::Width(const char *s) const
 int ciMonFont::DrawText(ciMonBitmap *Bitmap, int x, int y, const char *s, int Width) const
 {
   if (s && height) { // checking height to make sure we actually have a valid font
-     uint prevSym = 0;
+     uint prevIndex = 0;
      while (*s) {
            int sl = Utf8CharLen(s);
            uint sym = Utf8CharGet(s, sl);
@@ -202,24 +426,16 @@ int ciMonFont::DrawText(ciMonBitmap *Bitmap, int x, int y, const char *s, int Wi
            ciMonGlyph *g = Glyph(sym);
            if (!g)
               continue;
-           int kerning = Kerning(g, prevSym);
-           prevSym = sym;
-           uchar *buffer = g->Bitmap();
+           int kerning = Kerning(g, prevIndex);
+           prevIndex = g->Index();
            int symWidth = g->Width();
            if (Width && x + symWidth + g->Left() + kerning - 1 > Width)
               return 1; // we don't draw partial characters
            if (x + symWidth + g->Left() + kerning > 0) {
-              for (int row = 0; row < g->Rows(); row++) {
-                  for (int pitch = 0; pitch < g->Pitch(); pitch++) {
-                      uchar bt = *(buffer + (row * g->Pitch() + pitch));
-                      for (int col = 0; col < 8 && col + pitch * 8 <= symWidth; col++) {
-                         if (bt & 0x80)
-                            Bitmap->SetPixel(x + col + pitch * 8 + g->Left() + kerning,
-                                             y + row + (height - Bottom() - g->Top()));
-                         bt <<= 1;
-                         }
-                      }
-                  }
+              int top = y + (height - Bottom() - g->Top());
+              int shift = top & 7;
+              Bitmap->OrColumns(x + g->Left() + kerning, (top - shift) / 8,
+                                g->Columns(shift), symWidth, g->ColumnRows(shift));
               }
            x += g->AdvanceX() + kerning;
            if (x > Bitmap->Width() - 1)
@@ -231,3 +447,183 @@ int ciMonFont::DrawText(ciMonBitmap *Bitmap, int x, int y, const char *s, int Wi
 }
 
 
+
+// --- ciMonFontFace ---------------------------------------------------------
+
+ciMonFontFace::ciMonFontFace(const char *FileName, FT_Face Face, uint64_t Hash)
+: fileName(FileName)
+{
+  face = Face;
+  hash = Hash;
+  fonts = 0;
+}
+
+ciMonFontFace::~ciMonFontFace()
+{
+  FT_Done_Face(face);
+}
+
+// --- ciMonFontEntry --------------------------------------------------------
+
+ciMonFontEntry::ciMonFontEntry(ciMonFont *Font, ciMonFontFace *Face, int CharHeight)
+{
+  font = Font;
+  face = Face;
+  charHeight = CharHeight;
+  users = 0;
+  face->fonts++;
+}
+
+ciMonFontEntry::~ciMonFontEntry()
+{
+  delete font;
+  face->fonts--;
+}
+
+// --- ciMonFontManager ------------------------------------------------------
+
+ciMonFontManager theFontManager;
+
+ciMonFontManager::ciMonFontManager(void)
+{
+  initialized = false;
+}
+
+ciMonFontManager::~ciMonFontManager()
+{
+  Clear();
+}
+
+/**
+ * Drop all cached fonts and faces, fonts must not be used anymore.
+ */
+void ciMonFontManager::Clear(void)
+{
+  cMutexLock lock(&mutex);
+  for (ciMonFontEntry *e = fonts.First(); e; e = fonts.Next(e))
+      e->font->SaveAtlas();
+  fonts.Clear();
+  faces.Clear();
+  if (initialized) {
+     FT_Done_FreeType(library);
+     initialized = false;
+     }
+}
+
+/**
+ * Set the directory for glyph atlas files, used by fonts loaded afterwards.
+ */
+void ciMonFontManager::SetCacheDirectory(const char *Directory)
+{
+  cMutexLock lock(&mutex);
+  cacheDirectory = Directory;
+}
+
+// caller must hold the mutex
+ciMonFontFace* ciMonFontManager::Face(const char *FileName)
+{
+  for (ciMonFontFace *f = faces.First(); f; f = faces.Next(f)) {
+      if (!strcmp(f->fileName, FileName))
+         return f;
+      }
+  if (!initialized) {
+     int error = FT_Init_FreeType(&library);
+     if (error) {
+        esyslog("iMonLCD: FreeType: initialization error %d (font = %s)", error, FileName);
+        return NULL;
+        }
+     initialized = true;
+     }
+  FT_Face face;
+  int error = FT_New_Face(library, FileName, 0, &face);
+  if (error) {
+     esyslog("iMonLCD: FreeType: load error %d (font = %s)", error, FileName);
+     return NULL;
+     }
+  uint64_t hash = 0;
+  if (!isempty(cacheDirectory))
+     hash = ciMonAtlas::HashFile(FileName);
+  ciMonFontFace *f = new ciMonFontFace(FileName, face, hash);
+  faces.Add(f);
+  return f;
+}
+
+/**
+ * Get a font of given file and size, it's loaded only if not cached.
+ * Every acquired font must be given back by Release().
+ * \param FileName    Full path of font file.
+ * \param CharHeight  Height of characters in points.
+ * \return NULL, if the font could not be loaded.
+ */
+ciMonFont* ciMonFontManager::Acquire(const char *FileName, int CharHeight)
+{
+  cMutexLock lock(&mutex);
+  for (ciMonFontEntry *e = fonts.First(); e; e = fonts.Next(e)) {
+      if (e->charHeight == CharHeight && !strcmp(e->face->fileName, FileName)) {
+         if (e != fonts.First()) {
+            fonts.Del(e, false);
+            fonts.Ins(e);
+            }
+         e->users++;
+         return e->font;
+         }
+      }
+
+  ciMonFontFace *f = Face(FileName);
+  if (!f)
+     return NULL;
+  ciMonFont *font = new ciMonFont(f->face, FileName, CharHeight);
+  if (!font->Height()) {
+     delete font;
+     if (!f->fonts)
+        faces.Del(f);
+     return NULL;
+     }
+  if (f->hash)
+     font->UseAtlas(ciMonAtlas::FileName(cacheDirectory, f->hash, CharHeight), f->hash);
+  ciMonFontEntry *e = new ciMonFontEntry(font, f, CharHeight);
+  e->users++;
+  fonts.Ins(e);
+  Trim();
+  return font;
+}
+
+/**
+ * Give back a font, which was acquired before.
+ */
+void ciMonFontManager::Release(const ciMonFont *Font)
+{
+  if (!Font)
+     return;
+  cMutexLock lock(&mutex);
+  for (ciMonFontEntry *e = fonts.First(); e; e = fonts.Next(e)) {
+      if (e->font == Font) {
+         if (e->users > 0)
+            e->users--;
+         break;
+         }
+      }
+  Trim();
+}
+
+// caller must hold the mutex, drop least recently acquired fonts without user
+void ciMonFontManager::Trim(void)
+{
+  int unused = 0;
+  for (ciMonFontEntry *e = fonts.First(); e; e = fonts.Next(e)) {
+      if (!e->users)
+         unused++;
+      }
+  for (ciMonFontEntry *e = fonts.Last(); e && unused > FONT_CACHE_UNUSED; ) {
+      ciMonFontEntry *prev = fonts.Prev(e);
+      if (!e->users) {
+         ciMonFontFace *f = e->face;
+         e->font->SaveAtlas();
+         fonts.Del(e);
+         if (!f->fonts)
+            faces.Del(f);
+         unused--;
+         }
+      e = prev;
+      }
+}
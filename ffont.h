@@ -18,67 +18,152 @@
 #include <vdr/font.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_SIZES_H
 #include "bitmap.h"
+#include "atlas.h"
 
 struct ciMonKerning {
-  uint prevSym;
+  uint prevIndex; ///< FreeType glyph index of previous glyph, 0 marks a free entry
+  uint index;     ///< FreeType glyph index
   int kerning;
-  ciMonKerning(uint PrevSym, int Kerning = 0) { prevSym = PrevSym; kerning = Kerning; }
   };
 
 class ciMonGlyph : public cListObject {
 private:
   uint charCode;
-  uchar *bitmap;
+  uint index; ///< The FreeType glyph index.
+  uchar *columns; ///< Bitmap in display layout, 8 vertical pixels per byte, for each of 8 vertical shifts.
+  int offset[8];  ///< Start of each shifted bitmap within columns.
+  int size;       ///< Total size of columns.
+  bool owned;     ///< false, if columns are part of a mapped atlas.
   int advanceX;
   int advanceY;
   int left;  ///< The bitmap's left bearing expressed in integer pixels.
   int top;   ///< The bitmap's top bearing expressed in integer pixels.
   int width; ///< The number of pixels per bitmap row.
   int rows;  ///< The number of bitmap rows.
-  int pitch; ///< The pitch's absolute value is the number of bytes taken by one bitmap row, including padding.
-  cVector<ciMonKerning> kerningCache;
 public:
-  ciMonGlyph(uint CharCode, FT_GlyphSlotRec_ *GlyphData);
+  ciMonGlyph(uint CharCode, uint Index, FT_GlyphSlotRec_ *GlyphData);
+  ciMonGlyph(const ciMonAtlasGlyph *Record, const uchar *Columns);
   virtual ~ciMonGlyph();
   uint CharCode(void) const { return charCode; }
-  uchar *Bitmap(void) const { return bitmap; }
+  uint Index(void) const { return index; }
+  /// Bitmap with its top row shifted down by Shift pixels, in display layout.
+  const uchar *Columns(int Shift) const { return columns + offset[Shift]; }
+  /// The number of byte rows of the bitmap shifted down by Shift pixels.
+  int ColumnRows(int Shift) const { return (rows + Shift + 7) / 8; }
+  int Size(void) const { return size; }
   int AdvanceX(void) const { return advanceX; }
   int AdvanceY(void) const { return advanceY; }
   int Left(void) const { return left; }
   int Top(void) const { return top; }
   int Width(void) const { return width; }
   int Rows(void) const { return rows; }
-  int Pitch(void) const { return pitch; }
-  int GeciMonKerningCache(uint PrevSym) const;
-  void SeciMonKerningCache(uint PrevSym, int Kerning);
   };
 
 
+#define GLYPH_DIRECT_SIZE 256  ///< Basic Latin and Latin-1 are direct indexed
+#define GLYPH_CACHE_SIZE  256  ///< Limit of cached glyphs for all other characters
+
 class ciMonFont : public cFont {
+  friend class ciMonFontManager;
 private:
   int height;
   unsigned int bottom;
   int width;
-  FT_Library library; ///< Handle to library
-  FT_Face face; ///< Handle to face object
-  mutable cList<ciMonGlyph> glyphCacheMonochrome;
+  FT_Face face; ///< Handle to face object, shared with other sizes
+  FT_Size size; ///< Handle to size object, owned by this instance
+  mutable ciMonGlyph* glyphDirect[GLYPH_DIRECT_SIZE];
+  mutable cHash<ciMonGlyph> glyphHash;
+  mutable cList<ciMonGlyph> glyphCacheMonochrome; ///< least recently used glyph at last
+  mutable unsigned int glyphHits;
+  mutable unsigned int glyphMisses;
+  mutable ciMonKerning* kerningTable; ///< open addressed hash of kerning pairs
+  mutable int kerningSize;
+  mutable int kerningCount;
+  ciMonAtlas atlas;
+  cString atlasFile;
+  uint64_t fontHash;
+  int charHeight;
+  mutable unsigned int glyphsRendered; ///< count of glyphs rendered by FreeType
+  ciMonGlyph* LoadGlyph(uint CharCode) const;
+  void UseAtlas(const char *FileName, uint64_t FontHash);
+  void SaveAtlas(void) const;
+  void AddKerning(uint PrevIndex, uint Index, int Kerning) const;
   int Bottom(void) const { return bottom; }
-  int Kerning(ciMonGlyph *Glyph, uint PrevSym) const;
+  int Kerning(ciMonGlyph *Glyph, uint PrevIndex) const;
   ciMonGlyph* Glyph(uint CharCode) const;
   virtual void DrawText(cBitmap*, int, int, const char*, tColor, tColor, int) const {};
   virtual void DrawText(cPixmap*, int, int, const char*, tColor, tColor, int) const {};
+  ciMonFont(FT_Face Face, const char *Name, int CharHeight, int CharWidth = 0);
 public:
-  ciMonFont(const char *Name, int CharHeight, int CharWidth = 0);
   virtual ~ciMonFont();
   virtual int Width(void) const { return width; }
   virtual int Width(uint c) const;
   virtual int Width(const char *s) const;
+  int PrefixWidth(const char *s, int Bytes) const;
   virtual int Height(void) const { return height; }
+  unsigned int GlyphHits(void) const { return glyphHits; }
+  unsigned int GlyphMisses(void) const { return glyphMisses; }
 
   int DrawText(ciMonBitmap *Bitmap, int x, int y, const char *s, int Width) const;
 };
 
+class ciMonFontFace : public cListObject {
+  friend class ciMonFontManager;
+  friend class ciMonFontEntry;
+private:
+  cString fileName;
+  FT_Face face;
+  uint64_t hash; ///< hash of font file, 0 if no atlas is used
+  int fonts; ///< count of sized instances, which use this face
+public:
+  ciMonFontFace(const char *FileName, FT_Face Face, uint64_t Hash);
+  virtual ~ciMonFontFace();
+  };
+
+class ciMonFontEntry : public cListObject {
+  friend class ciMonFontManager;
+private:
+  ciMonFont *font;
+  ciMonFontFace *face;
+  int charHeight;
+  int users;
+public:
+  ciMonFontEntry(ciMonFont *Font, ciMonFontFace *Face, int CharHeight);
+  virtual ~ciMonFontEntry();
+  };
+
+#define FONT_CACHE_UNUSED 4 ///< Limit of sized instances kept without a user
+
+/**
+ * Process-wide cache of fonts. All fonts share one FreeType library, each
+ * font file is opened once and every size gets its own FT_Size of the
+ * shared face. Instances stay alive while used and some more, so a switch
+ * between known sizes doesn't load anything.
+ */
+class ciMonFontManager {
+private:
+  cMutex mutex; ///< serializes all calls into FreeType
+  FT_Library library;
+  bool initialized;
+  cList<ciMonFontFace> faces;
+  cList<ciMonFontEntry> fonts; ///< most recently acquired at first
+  cString cacheDirectory; ///< directory of glyph atlas files
+  ciMonFontFace* Face(const char *FileName);
+  void Trim(void);
+public:
+  ciMonFontManager(void);
+  ~ciMonFontManager();
+  ciMonFont* Acquire(const char *FileName, int CharHeight);
+  void Release(const ciMonFont *Font);
+  void Clear(void);
+  void SetCacheDirectory(const char *Directory);
+  cMutex* Mutex(void) { return &mutex; }
+  };
+
+extern ciMonFontManager theFontManager;
+
 
 #endif
 
@@ -28,32 +28,11 @@
 #include "setup.h"
 #include "ffont.h"
 #include "imon.h"
+#include "stats.h"
 
 /*
- * Just for convenience and to have the commands at one place.
+ * Just for convenience and to have the icons at one place, see ciMonEncoder::Icons().
  */
-static const uint64_t CMD_SET_ICONS	        = (uint64_t) 0x0100000000000000LL;
-static const uint64_t CMD_SET_CONTRAST	    = (uint64_t) 0x0300000000000000LL;
-static const uint64_t CMD_DISPLAY	          = (uint64_t) 0x0000000000000000LL;  // must be or'd with the applicable CMD_DISPLAY_BYTE
-static const uint64_t CMD_SHUTDOWN	        = (uint64_t) 0x0000000000000008LL;  // must be or'd with the applicable CMD_DISPLAY_BYTE
-static const uint64_t CMD_DISPLAY_ON	      = (uint64_t) 0x0000000000000040LL;  // must be or'd with the applicable CMD_DISPLAY_BYTE
-static const uint64_t CMD_CLEAR_ALARM	      = (uint64_t) 0x0000000000000000LL;  // must be or'd with the applicable CMD_ALARM_BYTE
-static const uint64_t CMD_SET_LINES0	      = (uint64_t) 0x1000000000000000LL;
-static const uint64_t CMD_SET_LINES1	      = (uint64_t) 0x1100000000000000LL;
-static const uint64_t CMD_SET_LINES2	      = (uint64_t) 0x1200000000000000LL;
-static const uint64_t CMD_INIT		          = (uint64_t) 0x0200000000000000LL;  //not exactly sure what this does, but it's needed
-static const uint64_t CMD_LOW_CONTRAST	    = (uint64_t) (CMD_SET_CONTRAST + (uint64_t) 0x00FFFFFF00580A00LL);
-
-
-/* Allow for variations in Soundgraphs numerous protocols */
-/* 15c2:0038 SoundGraph iMON */
-static const uint64_t CMD_DISPLAY_BYTE_0038	= (uint64_t) 0x8800000000000000LL;
-static const uint64_t CMD_ALARM_BYTE_0038	  = (uint64_t) 0x8a00000000000000LL;
-
-/* 15c2:ffdc SoundGraph iMON */
-static const uint64_t CMD_DISPLAY_BYTE_FFDC	= (uint64_t) 0x5000000000000000LL;
-static const uint64_t CMD_ALARM_BYTE_FFDC	  = (uint64_t) 0x5100000000000000LL;
-
 /* Byte 6 */
 static const uint64_t ICON_DISK_OFF	  = (uint64_t) 0x7F7000FFFFFFFFFFLL;
 static const uint64_t ICON_DISK_ON	  = (uint64_t) 0x0080FF0000000000LL;
@@ -112,14 +91,95 @@ static const uint64_t ICON_WEBCAST    = ((uint64_t) 1 << 2);
 static const uint64_t ICON_NEWS	      = ((uint64_t) 1 << 1);
 static const uint64_t ICON_SPKR_FL	  = ((uint64_t) 1 << 0);
 
+/*
+ * Hardware bits of each group of eIcons, built by the compiler. A group is
+ * indexed by its bits of the icon state, so icons() needs only a few loads.
+ */
+#define ICON_IF(n, bit, icon) ((((n) >> (bit)) & 1) ? (icon) : 0)
+#define ICON_ROW4(f, n)   f(n), f((n) + 1), f((n) + 2), f((n) + 3)
+#define ICON_ROW16(f, n)  ICON_ROW4(f, n), ICON_ROW4(f, (n) + 4), ICON_ROW4(f, (n) + 8), ICON_ROW4(f, (n) + 12)
+#define ICON_ROW64(f, n)  ICON_ROW16(f, n), ICON_ROW16(f, (n) + 16), ICON_ROW16(f, (n) + 32), ICON_ROW16(f, (n) + 48)
+
+/* bit 1,2,3 : top row (0=none, 1=music, 2=movie, 3=photo, 4=CD/DVD, 5=TV, 6=Web, 7=News/Weather) */
+#define ICON_TOP_SHIFT 1
+static const uint64_t iconTop[8] = {
+  0, ICON_MUSIC, ICON_MOVIE, ICON_PHOTO, ICON_CD_DVD, ICON_TV, ICON_WEBCAST, ICON_NEWS
+};
+
+/* bit 4,5,6 : 'speaker' icons (0=off, 1=L, 2=R, 3=L+R, 4=5.1ch, 5=7.1ch, 6=SPDIF, 7=mute) */
+#define ICON_SPEAKER_SHIFT 4
+static const uint64_t iconSpeaker[8] = {
+  0,
+  ICON_SPKR_FL,
+  ICON_SPKR_FR,
+  ICON_SPKR_FL | ICON_SPKR_FR,
+  ICON_SPKR_FL | ICON_SPKR_FC | ICON_SPKR_FR | ICON_SPKR_RL | ICON_SPKR_RR,
+  ICON_SPKR_FL | ICON_SPKR_FC | ICON_SPKR_FR | ICON_SPKR_RL | ICON_SPKR_RR | ICON_SPKR_SL | ICON_SPKR_SR,
+  ICON_SPKR_SPDIF,
+  0
+};
+
+/* bit 7 .. 12 : sources and TV icons, one bit each */
+#define ICON_SOURCE_SHIFT 7
+#define ICON_SOURCE(n) (ICON_IF(n, 0, ICON_SRC) | ICON_IF(n, 1, ICON_FIT) | ICON_IF(n, 2, ICON_TV_2) \
+                      | ICON_IF(n, 3, ICON_HDTV) | ICON_IF(n, 4, ICON_SCR1) | ICON_IF(n, 5, ICON_SCR2))
+static const uint64_t iconSource[64] = { ICON_ROW64(ICON_SOURCE, 0) };
+
+/* bottom-right icons (MP3,OGG,WMA,WAV) */
+#define ICON_BR_SHIFT 13
+static const uint64_t iconBottomRight[8] = {
+  0, ICON_AUDIO_MP3, ICON_AUDIO_OGG, ICON_AUDIO_WMA2, ICON_AUDIO_WAV, 0, 0, 0
+};
+
+/* bottom-middle icons (MPG,AC3,DTS,WMA) */
+#define ICON_BM_SHIFT 16
+static const uint64_t iconBottomMiddle[8] = {
+  0, ICON_AUDIO_MPG, ICON_AUDIO_AC3, ICON_AUDIO_DTS, ICON_AUDIO_WMA, 0, 0, 0
+};
+
+/* bottom-left icons (MPG,DIVX,XVID,WMV) */
+#define ICON_BL_SHIFT 19
+static const uint64_t iconBottomLeft[8] = {
+  0, ICON_MPG, ICON_DIVX, ICON_XVID, ICON_WMV, 0, 0, 0
+};
+
+/* bit 22 .. 28 : status icons, one bit each */
+#define ICON_STATUS_SHIFT 22
+#define ICON_STATUS(n) (ICON_IF(n, 0, ICON_VOL) | ICON_IF(n, 1, ICON_TIME) | ICON_IF(n, 2, ICON_ALARM) \
+                      | ICON_IF(n, 3, ICON_REC) | ICON_IF(n, 4, ICON_REP) | ICON_IF(n, 5, ICON_SFL) \
+                      | ICON_IF(n, 6, ICON_DISK_IN))
+static const uint64_t iconStatus[128] = { ICON_ROW64(ICON_STATUS, 0), ICON_ROW64(ICON_STATUS, 64) };
+
+/*
+ * Frames of the spinning disc, a pair of opposite segments per frame.
+ * Index by DiscMode, 0 = segments on, 1 = all on except the segments.
+ */
+static const uint64_t iconDisc[2][4] = {
+  { /* top & bottom */       ((uint64_t) (128 | 8) << 40),
+    /* top-right & bottom-left */ ((uint64_t) (1 | 16) << 40),
+    /* right & left */       ((uint64_t) (32 | 2) << 40),
+    /* top-left & bottom-right */ ((uint64_t) (4 | 64) << 40) },
+  { ((uint64_t) (255 - 128 - 8) << 40),
+    ((uint64_t) (255 - 16 - 1) << 40),
+    ((uint64_t) (255 - 32 - 2) << 40),
+    ((uint64_t) (255 - 64 - 4) << 40) }
+};
+
 
 ciMonLCD::ciMonLCD() 
 {
 	this->imon_fd = -1;
 	this->framebuf = NULL;
 	this->backingstore = NULL;
+	this->refresh_all = true;
+	this->packets_skipped = 0;
 	this->last_cd_state = 0;
+	this->last_icons = 0;
+	this->last_state = 0;
+	this->encoder = NULL;
 	this->pFont = NULL;
+	this->pFontBig = NULL;
+	this->pFontSmall = NULL;
 }
 
 ciMonLCD::~ciMonLCD() {
@@ -141,30 +201,22 @@ int ciMonLCD::open(const char* szDevice, eProtocol pro)
 		return -1;
   }
 
-	isyslog("iMonLCD: using Device %s, with 15c2:%s", szDevice, 
-              (pro == ePROTOCOL_FFDC ? "ffdc":"0038"));
+	const ciMonEncoder* pEncoder = ciMonEncoder::Select(pro);
+	if (pEncoder == NULL) {
+		esyslog("iMonLCD: unknown protocol %d", pro);
+		return -1;
+	}
+	isyslog("iMonLCD: using Device %s, with 15c2:%s", szDevice, pEncoder->Name());
+	/* Set commands based on protocol version */
+	this->encoder = pEncoder;
 
 	/* Open device for writing */
 	if ((this->imon_fd = ::open(szDevice, O_WRONLY)) < 0) {
 		esyslog("iMonLCD: ERROR opening %s (%s).", szDevice, strerror(errno));
 		esyslog("iMonLCD: Did you load the iMON kernel module?");
+		ciMonStats::Add(theStats.openErrors);
 		return -1;
 	}
-
-	/* Set commands based on protocol version */
-	if (pro == ePROTOCOL_FFDC) {
-		this->cmd_display =      (CMD_DISPLAY | CMD_DISPLAY_BYTE_FFDC);
-		this->cmd_shutdown =     (CMD_SHUTDOWN | CMD_DISPLAY_BYTE_FFDC);
-		this->cmd_display_on =   (CMD_DISPLAY_ON | CMD_DISPLAY_BYTE_FFDC);
-		this->cmd_clear_alarm =  (CMD_CLEAR_ALARM | CMD_ALARM_BYTE_FFDC);
-	} else //if (pro == PROTOCOL_0038) 
-  {
-		this->cmd_display =      (CMD_DISPLAY | CMD_DISPLAY_BYTE_0038);
-		this->cmd_shutdown =     (CMD_SHUTDOWN | CMD_DISPLAY_BYTE_0038);
-		this->cmd_display_on =   (CMD_DISPLAY_ON | CMD_DISPLAY_BYTE_0038);
-		this->cmd_clear_alarm =  (CMD_CLEAR_ALARM | CMD_ALARM_BYTE_0038);
-	}
-
 	/* Make sure the frame buffer is there... */
 	this->framebuf = new ciMonBitmap(theSetup.m_nWidth,theSetup.m_nHeight);
 	if (this->framebuf == NULL) {
@@ -179,11 +231,20 @@ int ciMonLCD::open(const char* szDevice, eProtocol pro)
 		return -1;
 	}
 
+	if (!writer.Start(this->imon_fd)) {
+		esyslog("iMonLCD: unable to start writer thread");
+		return -1;
+	}
+
   if(SendCmdInit()) {
 	  Contrast(theSetup.m_nContrast);
-	  dsyslog("iMonLCD: init() done");
-	  return 0;
+	  if(writer.Flush()) { // wait for the device has accepted the init sequence
+	    dsyslog("iMonLCD: init() done");
+	    return 0;
+	  }
   }
+	writer.Stop();
+	ciMonStats::Add(theStats.openErrors);
 	return -1;
 }
 
@@ -194,16 +255,21 @@ int ciMonLCD::open(const char* szDevice, eProtocol pro)
  */
 bool ciMonLCD::SendCmdInit() {
 
-  backingstore->SetPixel(0,0);//make dirty
+  this->refresh_all = true; // display lost his content, resend whole frame
+  if(!this->isopen()) {
+    esyslog("iMonLCD: error writing to dead file descriptor");
+    return false;
+  }
 
-  return SendCmd(this->cmd_clear_alarm)
-      && SendCmd(this->cmd_display_on)
-	    && SendCmd(CMD_INIT)	/* unknown, required init command */
-	    && SendCmd(CMD_SET_ICONS)
+  this->last_icons = 0; // cleared by init sequence
+  return SendCmd(encoder->ClearAlarm())
+      && SendCmd(encoder->DisplayOn())
+	    && SendCmd(ciMonEncoder::Init())	/* unknown, required init command */
+	    && SendCmd(ciMonEncoder::ClearIcons())
 	    /* clear the progress-bars on top and bottom of the display */
-	    && SendCmd(CMD_SET_LINES0)
-	    && SendCmd(CMD_SET_LINES1)
-	    && SendCmd(CMD_SET_LINES2);
+	    && SendCmd(ciMonEncoder::ClearLines(0))
+	    && SendCmd(ciMonEncoder::ClearLines(1))
+	    && SendCmd(ciMonEncoder::ClearLines(2));
 }
 
 /*
@@ -212,8 +278,12 @@ bool ciMonLCD::SendCmdInit() {
  * off with this command)
  */
 bool ciMonLCD::SendCmdShutdown() {
-	return SendCmd(this->cmd_shutdown)
-         &&	SendCmd(this->cmd_clear_alarm);
+  if(!this->isopen()) {
+    esyslog("iMonLCD: error writing to dead file descriptor");
+    return false;
+  }
+	return SendCmd(encoder->Shutdown())
+         &&	SendCmd(encoder->ClearAlarm());
 }
 
 /*
@@ -222,34 +292,19 @@ bool ciMonLCD::SendCmdShutdown() {
  */
 bool ciMonLCD::SendCmdClock(time_t tAlarm) {
   time_t tt;
-  struct tm l;
-  uint64_t data;
-  uint64_t alarm;
+  struct tm l, a;
+  ciMonPacket data;
+  ciMonPacket alarm;
 
+  if(!this->isopen()) {
+    esyslog("iMonLCD: error writing to dead file descriptor");
+    return false;
+  }
   tt = time(NULL);
   localtime_r(&tt, &l);
-  
-  data = this->cmd_display;
-  alarm = this->cmd_clear_alarm;
-
-  data += ((uint64_t) l.tm_sec  << 48);
-  data += ((uint64_t) l.tm_min  << 40);
-  data += ((uint64_t) l.tm_hour << 32); 
-  data += ((uint64_t) l.tm_mday << 24);
-  data += ((uint64_t) l.tm_mon  << 16);
-  data += ((uint64_t) l.tm_year << 8);
-
-  if(!tAlarm) {
-    data += 0x80;
-  } else {
-    data += 0x24; // Works for me on 0038 (need check for ffdc)
-
-    localtime_r(&tAlarm, &l);
-    alarm += ((uint64_t) l.tm_min  << 24);
-    alarm += ((uint64_t) l.tm_hour << 16);
-    alarm += ((uint64_t) l.tm_mday << 8);
-    alarm += ((uint64_t) l.tm_mon  << 0);
-  }
+  if(tAlarm)
+    localtime_r(&tAlarm, &a);
+  encoder->Clock(l, tAlarm ? &a : NULL, data, alarm);
 
 	return SendCmd(data)
          && SendCmd(alarm);
@@ -260,15 +315,15 @@ bool ciMonLCD::SendCmdClock(time_t tAlarm) {
  */
 void ciMonLCD::close()
 {
+	/* write all pending data before the device is closed */
+	writer.Stop();
+
 	if (this->imon_fd >= 0) {
 		::close(this->imon_fd);
     this->imon_fd = -1;
 	}
 
-  if(pFont) {
-    delete pFont;
-    pFont = NULL;
-  }
+  UseFonts(NULL, NULL, false);
   if(framebuf) {
     delete framebuf;
     framebuf = NULL;
@@ -290,6 +345,15 @@ void ciMonLCD::clear()
     framebuf->clear();
 }
 
+/**
+ * Clear a part of the screen.
+ */
+void ciMonLCD::clear(int x, int y, int w, int h)
+{
+  if(framebuf)
+    framebuf->clear(x, y, w, h);
+}
+
 
 /**
  * Flush data on screen to the LCD.
@@ -307,21 +371,25 @@ bool ciMonLCD::flush()
   }
 
 	/*
-	 * The display only provides for a complete screen refresh. If
-	 * nothing has changed, don't refresh.
+	 * If nothing has changed, don't refresh.
 	 */
-  if ((*backingstore) == (*framebuf))
+  if (!FrameLost() && (*backingstore) == (*framebuf)) {
+    this->packets_skipped = 0x3c - 0x20;
+    ciMonStats::Add(theStats.framesSkipped);
 	  return true;
+  }
+  uint64_t nStart = ciMonWriter::NowUs();
 
 	/* send buffer for one command or display data */
-	unsigned char tx_buf[8];
+	unsigned char tx_buf[IMON_PACKET_SIZE];
 
-	int err;
+	int nSkipped = 0;
   const uchar* fb = framebuf->getBitmap();
+  const uchar* bs = backingstore->getBitmap();
 	int bytes = framebuf->Width() / 8 * framebuf->Height();
   
 
-	for (msb = 0x20; msb < 0x3c; msb++) {
+	for (msb = 0x20; msb < 0x3c; msb++, offset += packetSize, bytes -= packetSize) {
 		/* Copy the packet data from the frame buffer. */
     int nCopy = packetSize;
     if(bytes < nCopy) {
@@ -330,6 +398,17 @@ bool ciMonLCD::flush()
       else
         nCopy = 0;
     }
+
+    /*
+     * Each packet address his own memory register of the display,
+     * so only packets with changed contents need to send.
+     */
+    if(!this->refresh_all
+        && (0 == nCopy || 0 == memcmp(fb + offset, bs + offset, nCopy))) {
+      ++nSkipped;
+      continue;
+    }
+
     if(nCopy!=packetSize) {
       memset(tx_buf, 0xFF , packetSize);
     }
@@ -339,22 +418,70 @@ bool ciMonLCD::flush()
 		/* Add the memory register byte to the packet data. */
 		tx_buf[packetSize] = msb;
 
-    //uint64_t *v = (uint64_t*)tx_buf;
-    //dsyslog("iMonLCD: writing : %08llx", *v);
-
-  	err = write(this->imon_fd, tx_buf, sizeof(tx_buf));
-    cCondWait::SleepMs(2);
-
-  	if (err <= 0)
-  		esyslog("iMonLCD: error writing to file descriptor: %d (%s)", err, strerror(errno));
-
-		offset += packetSize;
-    bytes -= packetSize;
+		/* The writer thread send only the latest contents of each register. */
+    writer.Packet(msb - 0x20, tx_buf);
 	}
+  this->packets_skipped = nSkipped;
+  this->refresh_all = false;
 
 	/* Update the backing store. */
   (*backingstore) = (*framebuf);
-  return (err > 0);
+
+  ciMonStats::Add(theStats.framesFlushed);
+  ciMonStats::Add(theStats.packetsPosted, (0x3c - 0x20) - nSkipped);
+  theStats.flushDuration.Add(ciMonWriter::NowUs() - nStart);
+  return true;
+}
+
+
+/**
+ * Check for display memory, which the writer failed to write.
+ * The backing store doesn't match the display then, so the next flush()
+ * resend the whole frame.
+ * \return true, if the next flush() must resend the whole frame.
+ */
+bool ciMonLCD::FrameLost()
+{
+  if(writer.FrameFailed())
+    this->refresh_all = true;
+  return this->refresh_all;
+}
+
+/**
+ * Render and flush frames as fast as possible, each with changed contents.
+ * Every frame waits until it's written, so the result include the pace of the device.
+ * \param nFrames  Count of frames to render.
+ * \param result   Measured time and written data.
+ */
+bool ciMonLCD::Benchmark(int nFrames, ciMonBenchmark& result)
+{
+  static const char* szText = "The quick brown fox jumps over the lazy dog - 0123456789";
+
+  memset(&result, 0, sizeof(result));
+  if(!this->isopen() || !pFont || !framebuf)
+    return false;
+
+  int nTop = (framebuf->Height() - pFont->Height()) / 2;
+  int nWidth = pFont->Width(szText);
+
+  writer.Flush();
+  writer.Statistics(result.writer, true);
+  uint64_t nStart = ciMonWriter::NowUs();
+  uint64_t nAllocStart = 0;
+  for(int n = 0; n < nFrames; ++n) {
+    if(n == 1) // first frame fills the caches
+      nAllocStart = ciMonStats::Allocations();
+    this->clear();
+    this->DrawScrollText(nTop < 0 ? 0 : nTop, szText, (n * 2) % nWidth);
+    if(!this->flush() || !writer.Flush())
+      break;
+    ++result.frames;
+  }
+  result.elapsed = ciMonWriter::NowUs() - nStart;
+  if(result.frames > 1)
+    result.allocations = ciMonStats::Allocations() - nAllocStart;
+  writer.Statistics(result.writer, true);
+  return result.frames == nFrames;
 }
 
 
@@ -372,6 +499,22 @@ int ciMonLCD::DrawText(int x, int y, const char* string)
   return -1;
 }
 
+/**
+ * Print a string, which may need scrolling, on the screen at vertical position y.
+ * The string is rasterized once, for each scroll offset only the visible part
+ * is copied into the frame buffer.
+ * \param y        Vertical character position (row).
+ * \param string   String that gets written.
+ * \param nOffset  Horizontal scroll offset.
+ * \return 1 if the string continues beyond the right edge.
+ */
+int ciMonLCD::DrawScrollText(int y, const char* string, int nOffset)
+{
+  if(pFont && framebuf
+     && marquee.Prepare(pFont, y, framebuf->Height(), string))
+    return marquee.Draw(framebuf, nOffset);
+  return -1;
+}
 
 /**
  * Sets the "icons state" for the device. We use this to control the icons
@@ -385,160 +528,66 @@ bool ciMonLCD::icons(unsigned int state)
 
 	/* bit 0 : disc icon (0=off, 1='spin') */
 	if ((state & eIconDiscSpin) != 0) {
-    bool bSpinIcon = ((state & eIconDiscRunSpin) != 0);
-    bool bSpinBackward ((state & eIconDiscSpinBackward) != 0);
-
-		switch (bSpinIcon ? this->last_cd_state : 3) {
-		case 0:
-			this->last_cd_state = bSpinBackward ? 3 : 1;
-			if (theSetup.m_bDiscMode == 1)
-				/* all on except top & bottom */
-				icon |= ((uint64_t) (255 - 128 - 8) << 40);
-			else
-				/* top & bottom on */
-				icon |= ((uint64_t) (128 | 8) << 40);
-			break;
-		case 1:
-			this->last_cd_state = bSpinBackward ? 0 : 2;
-			if (theSetup.m_bDiscMode == 1)
-				/* all on except top-right & bottom-left */
-				icon |= ((uint64_t) (255 - 16 - 1) << 40);
-			else
-				/* top-right & bottom-left on */
-				icon |= ((uint64_t) (1 | 16) << 40);
-			break;
-		case 2:
-			this->last_cd_state = bSpinBackward ? 1 : 3;
-			if (theSetup.m_bDiscMode == 1)
-				/* all on except right & left */
-				icon |= ((uint64_t) (255 - 32 - 2) << 40);
-			else
-				/* right & left on */
-				icon |= ((uint64_t) (32 | 2) << 40);
-			break;
-		default:
-			this->last_cd_state = bSpinBackward ? 2 : 0;
-			if (theSetup.m_bDiscMode == 1)
-				/* all on except top-left & bottom-right */
-				icon |= ((uint64_t) (255 - 64 - 4) << 40);
-			else
-				/* top-left & bottom-right on */
-				icon |= ((uint64_t) (4 | 64) << 40);
-			break;
-		}
+		/* the frame of a spinning disc is advanced by SpinDisc() */
+		int nFrame = ((state & eIconDiscRunSpin) != 0) ? this->last_cd_state : 3;
+		icon |= iconDisc[theSetup.m_bDiscMode == 1 ? 1 : 0][nFrame];
 	}
 
-	/*
-	 * bit 1,2,3 : top row (0=none, 1=music, 2=movie, 3=photo, 4=CD/DVD,
-	 * 5=TV, 6=Web, 7=News/Weather)
-	 */
-	switch (state & eIconTopMask) {
-		case eIconTopMusic: icon |= ICON_MUSIC;  break;
-		case eIconTopMovie: icon |= ICON_MOVIE;  break;
-		case eIconTopPhoto: icon |= ICON_PHOTO;  break;
-		case eIconTopDVD:   icon |= ICON_CD_DVD;	break;
-		case eIconTopTV:    icon |= ICON_TV;			break;
-		case eIconTopWeb:   icon |= ICON_WEBCAST;break;
-		case eIconTopNews:  icon |= ICON_NEWS;   break;
-		default:                                      break;
-	}
+	icon |= iconTop[(state & eIconTopMask) >> ICON_TOP_SHIFT];
+	icon |= iconSpeaker[(state & eIconSpeakerMask) >> ICON_SPEAKER_SHIFT];
+	icon |= iconSource[(state >> ICON_SOURCE_SHIFT) & 0x3F];
+	icon |= iconBottomRight[(state & eIconBR_Mask) >> ICON_BR_SHIFT];
+	icon |= iconBottomMiddle[(state & eIconBM_Mask) >> ICON_BM_SHIFT];
+	icon |= iconBottomLeft[(state & eIconBL_Mask) >> ICON_BL_SHIFT];
+	icon |= iconStatus[(state >> ICON_STATUS_SHIFT) & 0x7F];
 
-	/* bit 4,5 : 'speaker' icons (0=off, 1=L+R, 2=5.1ch, 3=7.1ch) */
-	switch (state & eIconSpeakerMask) {
-    case eIconSpeakerL:  icon |= ICON_SPKR_FL; break;
-		case eIconSpeakerR:  icon |= ICON_SPKR_FR; break;
-		case eIconSpeakerLR: icon |= ICON_SPKR_FL | ICON_SPKR_FR;		break;
-		case eIconSpeaker51: 
-      icon |= ICON_SPKR_FL | ICON_SPKR_FC | ICON_SPKR_FR | ICON_SPKR_RL | ICON_SPKR_RR;
-			break;
-		case eIconSpeaker71:
-			icon |= ICON_SPKR_FL | ICON_SPKR_FC | ICON_SPKR_FR | ICON_SPKR_RL | ICON_SPKR_RR | ICON_SPKR_SL | ICON_SPKR_SR;
-			break;
-		case eIconSPDIF:
-			icon |= ICON_SPKR_SPDIF;
-		case eIconMute:
-		default: break;
-	}
-
-	icon |= ((state & eIconSRC) != 0) ?  ICON_SRC : 0;
-	icon |= ((state & eIconFIT) != 0) ?  ICON_FIT : 0;
-	icon |= ((state & eIconTV) != 0) ?   ICON_TV_2 : 0;
-	icon |= ((state & eIconHDTV) != 0) ? ICON_HDTV : 0;
-	icon |= ((state & eIconSRC1) != 0) ? ICON_SCR1 : 0;
-	icon |= ((state & eIconSRC2) != 0) ? ICON_SCR2 : 0;
-
-	/* bottom-right icons (MP3,OGG,WMA,WAV) */
-  switch (state & eIconBR_Mask) {
-		case eIconBR_MP3: icon |= ICON_AUDIO_MP3; break;
-		case eIconBR_OGG: icon |= ICON_AUDIO_OGG; break;
-		case eIconBR_WMA: icon |= ICON_AUDIO_WMA2; break;
-		case eIconBR_WAV: icon |= ICON_AUDIO_WAV; break;
-		default:
-			break;
-	}
-
-	/* bottom-middle icons (MPG,AC3,DTS,WMA) */
-  switch (state & eIconBM_Mask) {
-		case eIconBM_MPG: icon |= ICON_AUDIO_MPG; break;
-		case eIconBM_AC3: icon |= ICON_AUDIO_AC3; break;
-		case eIconBM_DTS: icon |= ICON_AUDIO_DTS; break;
-		case eIconBM_WMA: icon |= ICON_AUDIO_WMA; break;
-		default: break;
-	}
-
-	/* bottom-left icons (MPG,DIVX,XVID,WMV) */
-  switch (state & eIconBL_Mask) {
-		case eIconBL_MPG:   icon |= ICON_MPG;  break;
-		case eIconBL_DIVX:  icon |= ICON_DIVX; break;
-		case eIconBL_XVID:  icon |= ICON_XVID; break;
-		case eIconBL_WMV:   icon |= ICON_WMV;  break;
-		default: break;
-	}
-
-	icon |= ((state & eIconVolume) != 0)      ? ICON_VOL : 0;
-	icon |= ((state & eIconTime) != 0)        ? ICON_TIME : 0;
-	icon |= ((state & eIconAlarm) != 0)       ? ICON_ALARM : 0;
-	icon |= ((state & eIconRecording) != 0)   ? ICON_REC : 0;
-	icon |= ((state & eIconRepeat) != 0)      ? ICON_REP : 0;
-	icon |= ((state & eIconShuffle) != 0)     ? ICON_SFL : 0;
-	icon |= ((state & eIconDiscEllispe) != 0) ? ICON_DISK_IN : 0;
+  this->last_state = state;
+  if(!this->isopen())
+    return false;
+	/* the display keeps the icons, so an unchanged state isn't written again */
+	if(icon == this->last_icons)
+		return true;
+	this->last_icons = icon;
+
+	/* only the latest icon state is written */
+	ciMonPacket packet;
+	ciMonEncoder::Icons(icon, packet);
+	writer.Icons(packet.data);
+	ciMonStats::Add(theStats.iconCommands);
+	return true;
+}
 
-	return SendCmd(CMD_SET_ICONS | icon);
+/**
+ * Show the next frame of the spinning disc, with the icons of the last call
+ * of icons(). Only the icon command is written.
+ * \return false, if the disc doesn't spin.
+ */
+bool ciMonLCD::SpinDisc()
+{
+	const unsigned int spin = eIconDiscSpin | eIconDiscRunSpin;
+	if ((this->last_state & spin) != spin)
+		return false;
+	bool bSpinBackward = ((this->last_state & eIconDiscSpinBackward) != 0);
+	this->last_cd_state = (this->last_cd_state + (bSpinBackward ? 3 : 1)) & 3;
+	return icons(this->last_state);
 }
 
 /**
- * Sends a command to the screen. The kernel module expects data to be
- * sent in 8 byte chunks, so for simplicity, we allow you to define
- * the data as a 64-bit integer.
- * However, we have to reverse the bytes to the order the display requires.
+ * Sends a command to the screen. The command is queued and written 
+ * in order by the writer thread.
  *
  * \param value  The data to send. Must be in a format that is recognized by
  *               the device. The kernel module doesn't actually do validation.
- * \return  <= 0 error writing to file descriptor.
+ * \return  false if the device isn't opened.
  */
-bool ciMonLCD::SendCmd(const uint64_t & cmdData) {
-	unsigned int i;
-	unsigned char buf[8];
-  
+bool ciMonLCD::SendCmd(const ciMonPacket & cmd) {
   if(!this->isopen()) {
     esyslog("iMonLCD: error writing to dead file descriptor");
     return false;
   }
-  //dsyslog("iMonLCD: writing : %08llx", cmdData);
 
-	/* Fill the send buffer. */
-	for (i = 0; i < sizeof(buf); i++) {
-		buf[i] = (unsigned char)((cmdData >> (i * 8)) & 0xFF);
-	}
-
-	int err;
-	err = write(this->imon_fd, buf, sizeof(buf));
-  cCondWait::SleepMs(2);
-
-	if (err <= 0)
-		esyslog("iMonLCD: error writing to file descriptor: %d (%s)", err, strerror(errno));
-
-  return (err > 0);
+  ciMonStats::Add(theStats.commands);
+  return writer.Command(cmd.data);
 }
 
 /**
@@ -561,7 +610,12 @@ bool ciMonLCD::Contrast(int nContrast)
 	 * to 40). 0 is the lowest and 40 is the highest. The actual
 	 * perceived contrast varies depending on the type of display.
 	 */
-	return SendCmd(CMD_LOW_CONTRAST + (uint64_t) (nContrast / 25));
+  if(!this->isopen())
+    return false;
+	ciMonPacket packet;
+	ciMonEncoder::Contrast(nContrast / 25, packet);
+	writer.Contrast(packet.data);
+	return true;
 }
 
 /**
@@ -601,23 +655,16 @@ void ciMonLCD::setLineLength(int topLine, int botLine, int topProgress, int botP
 void ciMonLCD::setBuiltinProgressBars(int topLine, int botLine,
 		       int topProgress, int botProgress)
 {
-	/* Least sig. bit is on the right */
-	uint64_t data;
-
-	/* send bytes 1-4 of topLine and 1-3 of topProgress */
-	data = (uint64_t) topLine & 0x00000000FFFFFFFFLL;
-	data |= (((uint64_t) topProgress) << 8 * 4) & 0x00FFFFFF00000000LL;
-	SendCmd(CMD_SET_LINES0 | data);
-
-	/* send byte 4 of topProgress, bytes 1-4 of botProgress and 1-2 of botLine */
-	data = (((uint64_t) topProgress) >> 8 * 3) & 0x00000000000000FFLL;
-	data |= (((uint64_t) botProgress) << 8) & 0x000000FFFFFFFF00LL;
-	data |= (((uint64_t) botLine) << 8 * 5) & 0x00FFFF0000000000LL;
-	SendCmd(CMD_SET_LINES1 | data);
-
-	/* send remaining bytes 3-4 of botLine */
-	data = ((uint64_t) botLine) >> 8 * 2;
-	SendCmd(CMD_SET_LINES2 | data);
+	ciMonPacket packets[3];
+
+	if(!this->isopen())
+		return;
+
+	ciMonEncoder::Lines(topLine, botLine, topProgress, botProgress, packets);
+
+	/* only the latest state of the bars is written */
+	writer.Lines(packets[0].data, packets[1].data, packets[2].data);
+	ciMonStats::Add(theStats.barCommands);
 }
 
 /**
@@ -651,28 +698,58 @@ unsigned int ciMonLCD::lengthToPixels(int length)
 		return (pixLen[32 + length] ^ 0xffffffff);
 }
 
-bool ciMonLCD::SetFont(const char *szFont, bool bTwoLineMode, int nBigFontHeight, int nSmallFontHeight) {
+/**
+ * Get big and small font of a font family from theFontManager.
+ * This could load the fonts, so it should be called without holding any lock.
+ */
+bool ciMonLCD::LoadFonts(const char *szFont, int nBigFontHeight, int nSmallFontHeight,
+                         ciMonFont*& pBig, ciMonFont*& pSmall) const {
 
-  ciMonFont* tmpFont = NULL;
+  pBig = pSmall = NULL;
 
   cString sFileName = cFont::GetFontFileName(szFont);
-  if(!isempty(sFileName))
-  {
-    if (bTwoLineMode) {
-      tmpFont = new ciMonFont(sFileName,nSmallFontHeight);
-    } else {
-      tmpFont = new ciMonFont(sFileName,nBigFontHeight);
-    }
-  } else {
+  if(isempty(sFileName)) {
 		esyslog("iMonLCD: unable to find file for font '%s'",szFont);
+    return false;
   }
-  if(tmpFont) {
-    if(pFont) {
-      delete pFont;
-    }
-    pFont = tmpFont;
-    return true;
+  pBig = theFontManager.Acquire(sFileName, nBigFontHeight);
+  pSmall = theFontManager.Acquire(sFileName, nSmallFontHeight);
+  if(!pBig || !pSmall) {
+    theFontManager.Release(pBig);
+    theFontManager.Release(pSmall);
+    pBig = pSmall = NULL;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Replace the used fonts, the previous fonts are given back to theFontManager.
+ */
+void ciMonLCD::UseFonts(ciMonFont* pBig, ciMonFont* pSmall, bool bTwoLineMode) {
+
+  ciMonFont* pOldBig = pFontBig;
+  ciMonFont* pOldSmall = pFontSmall;
+
+  pFontBig = pBig;
+  pFontSmall = pSmall;
+  ciMonFont* pNewFont = bTwoLineMode ? pSmall : pBig;
+  if(pNewFont != pFont) {
+    marquee.Clear();
+    pFont = pNewFont;
   }
-  return false;
+
+  theFontManager.Release(pOldBig);
+  theFontManager.Release(pOldSmall);
+}
+
+bool ciMonLCD::SetFont(const char *szFont, bool bTwoLineMode, int nBigFontHeight, int nSmallFontHeight) {
+
+  ciMonFont* pBig;
+  ciMonFont* pSmall;
+  if(!LoadFonts(szFont, nBigFontHeight, nSmallFontHeight, pBig, pSmall))
+    return false;
+  UseFonts(pBig, pSmall, bTwoLineMode);
+  return true;
 }
 
@@ -15,11 +15,9 @@
 #define __IMON_LCD_H_
 
 #include "bitmap.h"
-
-enum eProtocol {
-  ePROTOCOL_FFDC   =   0,	/**< protocol ID for 15c2:ffdc device */
-  ePROTOCOL_0038   =   1	/**< protocol ID for 15c2:0038 device */
-};
+#include "writer.h"
+#include "marquee.h"
+#include "encoder.h"
 
 enum eIcons {
   eIconOff = 0,
@@ -83,39 +81,66 @@ enum eIcons {
   eIconDiscSpinBackward = 1 << 30
 };
 
+/**
+ * Result of a benchmark, see ciMonLCD::Benchmark().
+ */
+struct ciMonBenchmark {
+  int      frames;
+  uint64_t elapsed;       ///< microseconds for all frames
+  uint64_t allocations;   ///< heap allocations after the first frame, see ciMonStats::Allocations()
+  ciMonWriterStats writer;
+};
+
 class ciMonFont;
 class ciMonLCD {
 
 	int imon_fd;
 
+	/* all data are written to the device by this thread */
+	ciMonWriter writer;
+
 	/* framebuffer and backingstore for current contents */
 	ciMonBitmap* framebuf;
 	ciMonBitmap* backingstore;
 
-	/* store commands appropriate for the version of the iMON LCD */
-	uint64_t cmd_display;
-	uint64_t cmd_shutdown;
-	uint64_t cmd_display_on;
-	uint64_t cmd_clear_alarm;
+	/* resend all packets of the next frame, e.g. after display was initialized */
+	bool refresh_all;
+	/* count of unchanged packets, which was skipped by last flush */
+	int packets_skipped;
+
+	/* commands appropriate for the version of the iMON LCD */
+	const ciMonEncoder* encoder;
 
 	/*
 	 * record the last "state" of the CD icon so that we can "animate"
-	 * it.
+	 * it, advanced only by SpinDisc().
 	 */
 	int last_cd_state;
 
+	/* icons shown by the display, see icons() */
+	uint64_t last_icons;
+	unsigned int last_state;
+
 protected:
-  ciMonFont*   pFont;
+  ciMonFont*   pFont;       ///< font of current render mode, one of both below
+  ciMonFont*   pFontBig;
+  ciMonFont*   pFontSmall;
+  ciMonMarquee marquee;
+
+  bool LoadFonts(const char *szFont, int nBigFontHeight, int nSmallFontHeight,
+                 ciMonFont*& pBig, ciMonFont*& pSmall) const;
+  void UseFonts(ciMonFont* pBig, ciMonFont* pSmall, bool bTwoLineMode);
 
   void setLineLength(int topLine, int botLine, int topProgress, int botProgress);
   void setBuiltinProgressBars(int topLine, int botLine, int topProgress, int botProgress);
   unsigned int lengthToPixels(int length);
 
-  bool SendCmd(const uint64_t & cmdData);
+  bool SendCmd(const ciMonPacket & cmd);
   bool SendCmdClock(time_t tAlarm);
   bool SendCmdInit();
   bool SendCmdShutdown();
   bool Contrast(int nContrast);
+  bool FrameLost();
 
   void close();
 public:
@@ -126,10 +151,15 @@ public:
 
   bool isopen() const { return imon_fd >= 0; }
   void clear ();
+  void clear (int x, int y, int w, int h);
   int DrawText(int x, int y, const char* string);
+  int DrawScrollText(int y, const char* string, int nOffset);
   bool flush ();
+  int PacketsSkipped() const { return packets_skipped; }
+  bool Benchmark(int nFrames, ciMonBenchmark& result);
 
   bool icons(unsigned int state);
+  bool SpinDisc();
   virtual bool SetFont(const char *szFont, bool bTwoLineMode, int nBigFontHeight, int nSmallFontHeight);
 };
 #endif
@@ -15,10 +15,12 @@
 #include <getopt.h>
 #include <string.h>
 
+#include "ffont.h"
 #include "imon.h"
 #include "watch.h"
 #include "status.h"
 #include "setup.h"
+#include "stats.h"
 
 static const char *VERSION        = "1.0.3";
 
@@ -28,6 +30,7 @@ class cPluginImonlcd : public cPlugin {
 private:
   ciMonStatusMonitor *statusMonitor;
   char*              m_szDevice;
+  char*              m_szMetrics;
   ciMonWatch         m_dev;
   eProtocol          m_Protocol;
   bool               m_bSuspend;
@@ -39,6 +42,9 @@ protected:
   const char* SVDRPCommandOn(const char *Option, int &ReplyCode);
   const char* SVDRPCommandOff(const char *Option, int &ReplyCode);
   const char* SVDRPCommandIcon(const char *Option, int &ReplyCode);
+  cString SVDRPCommandBench(const char *Option, int &ReplyCode);
+  cString SVDRPCommandStat(const char *Option, int &ReplyCode);
+  cString SVDRPCommandSession(const char *Option, int &ReplyCode);
 
 public:
   cPluginImonlcd(void);
@@ -69,6 +75,7 @@ cPluginImonlcd::cPluginImonlcd(void)
   m_bSuspend = true;
   statusMonitor = NULL;
   m_szDevice = NULL;
+  m_szMetrics = NULL;
   m_szIconHelpPage = NULL;
 }
 
@@ -85,6 +92,11 @@ cPluginImonlcd::~cPluginImonlcd()
     m_szDevice = NULL;
   }  
 
+  if(m_szMetrics) {
+    free(m_szMetrics);
+    m_szMetrics = NULL;
+  }
+
   if(m_szIconHelpPage) {
     free(m_szIconHelpPage);
     m_szIconHelpPage = NULL;
@@ -98,7 +110,8 @@ const char *cPluginImonlcd::CommandLineHelp(void)
 "  -d DEV,   --device=DEV     sets the lcd-device to other device than /dev/lcd0\n"
 "  -p MODE,  --protocol=MODE  sets the protocol of lcd-device\n"
 "    '0038'                   For LCD with ID 15c2:0038 SoundGraph Inc (default)\n"
-"    'ffdc'                   For LCD with ID 15c2:ffdc SoundGraph Inc\n";
+"    'ffdc'                   For LCD with ID 15c2:ffdc SoundGraph Inc\n"
+"  -m FILE,  --metrics=FILE   write metrics periodically to FILE (Prometheus text format)\n";
 
 }
 
@@ -108,12 +121,13 @@ bool cPluginImonlcd::ProcessArgs(int argc, char *argv[])
   {
     { "device",   required_argument, NULL, 'd'},
     { "protocol", required_argument, NULL, 'p'},
+    { "metrics",  required_argument, NULL, 'm'},
     { NULL}
   };
 
   int c;
   int option_index = 0;
-  while ((c = getopt_long(argc, argv, "d:p:", long_options, &option_index)) != -1)
+  while ((c = getopt_long(argc, argv, "d:p:m:", long_options, &option_index)) != -1)
   {
     switch (c)
     {
@@ -135,6 +149,14 @@ bool cPluginImonlcd::ProcessArgs(int argc, char *argv[])
         }
         break;
       }
+      case 'm':
+      {
+        if(m_szMetrics) {
+          free(m_szMetrics);
+        }
+        m_szMetrics = strdup(optarg);
+        break;
+      }
       default:
         return false;
     }
@@ -178,6 +200,8 @@ bool cPluginImonlcd::suspend() {
 
 bool cPluginImonlcd::Start(void)
 {
+  theFontManager.SetCacheDirectory(CacheDirectory(PLUGIN_NAME_I18N));
+  m_dev.SetMetricsFile(m_szMetrics);
   if(resume()) {
       statusMonitor = new ciMonStatusMonitor(&m_dev);
       if(NULL == statusMonitor){
@@ -196,6 +220,7 @@ void cPluginImonlcd::Stop(void)
   }
 
   m_dev.shutdown(theSetup.m_nOnExit);
+  theFontManager.Clear();
   
   if(m_szDevice) {
     free(m_szDevice);
@@ -385,10 +410,98 @@ const char* cPluginImonlcd::SVDRPCommandIcon(const char *Option, int &ReplyCode)
   return "wrong parameter";
 }
 
+cString cPluginImonlcd::SVDRPCommandBench(const char *Option, int &ReplyCode)
+{
+  if(m_bSuspend) {
+      ReplyCode=251; 
+      return "driver suspended";
+  }
+  int nFrames = 100;
+  if(Option && *Option) {
+    nFrames = atoi(Option);
+    if(nFrames <= 0 || nFrames > 10000) {
+      ReplyCode=501; 
+      return "wrong parameter";
+    }
+  }
+
+  ciMonBenchmark r;
+  bool bOk = m_dev.Benchmark(nFrames, r);
+  if(bOk && r.allocations) {
+    // steady state should not allocate, see tools/imonlcd-alloc.c
+    ReplyCode = 554;
+    return cString::sprintf("benchmark failed, %llu heap allocations while rendering %d frames",
+                            (unsigned long long)r.allocations, r.frames - 1);
+  }
+  ReplyCode = bOk ? 250 : 554;
+  double dSeconds = r.elapsed / 1000000.0;
+  return cString::sprintf("%s %d frames in %.3f s, %.1f frames/s, %.1f bytes/frame, "
+                          "write latency avg %llu us max %llu us, %u errors",
+                          bOk ? "benchmark done," : "benchmark failed,",
+                          r.frames, dSeconds,
+                          dSeconds > 0 ? r.frames / dSeconds : 0.0,
+                          r.frames ? (double)r.writer.bytes / r.frames : 0.0,
+                          (unsigned long long)(r.writer.writes ? r.writer.latencySum / r.writer.writes : 0),
+                          (unsigned long long)r.writer.latencyMax,
+                          r.writer.errors);
+}
+
+cString cPluginImonlcd::SVDRPCommandSession(const char *Option, int &ReplyCode)
+{
+  if(m_bSuspend) {
+      ReplyCode=251; 
+      return "driver suspended";
+  }
+  int nCycles = 3;
+  if(Option && *Option) {
+    nCycles = atoi(Option);
+    if(nCycles < 2 || nCycles > 100) {
+      ReplyCode=501; 
+      return "wrong parameter";
+    }
+  }
+
+  ciMonSessionResult r;
+  if(!m_dev.Session(nCycles, r)) {
+    ReplyCode = 554;
+    return "session failed, display isn't running";
+  }
+  if(!ciMonStats::CountsAllocations()) {
+    ReplyCode = 252;
+    return cString::sprintf("session done, %d cycles, %llu iterations, heap allocations not counted",
+                            r.cycles, (unsigned long long)r.iterations);
+  }
+  if(r.allocations) {
+    // steady state should not allocate, see tools/imonlcd-alloc.c
+    ReplyCode = 554;
+    return cString::sprintf("session failed, %llu heap allocations in %llu of %llu iterations after warm-up",
+                            (unsigned long long)r.allocations, (unsigned long long)r.loopsAllocating,
+                            (unsigned long long)r.iterations);
+  }
+  ReplyCode = 250;
+  return cString::sprintf("session done, %d cycles, %llu iterations without heap allocations",
+                          r.cycles, (unsigned long long)r.iterations);
+}
+
+cString cPluginImonlcd::SVDRPCommandStat(const char *Option, int &ReplyCode)
+{
+  if(Option && *Option) {
+    if(strcasecmp(Option, "RESET")) {
+      ReplyCode=501; 
+      return "wrong parameter";
+    }
+    theStats.Reset();
+    ReplyCode=250; 
+    return "statistics reset";
+  }
+  ReplyCode=250; 
+  return theStats.Report();
+}
+
 cString cPluginImonlcd::SVDRPCommand(const char *Command, const char *Option, int &ReplyCode)
 {
   ReplyCode=501; 
-  const char* szReplay = "unknown command";
+  cString szReplay = "unknown command";
 
   if(!strcasecmp(Command, "ON")) {
     szReplay = SVDRPCommandOn(Option,ReplyCode);
@@ -396,9 +509,15 @@ cString cPluginImonlcd::SVDRPCommand(const char *Command, const char *Option, in
     szReplay = SVDRPCommandOff(Option,ReplyCode);
   } else if(!strcasecmp(Command, "ICON")) {
     szReplay = SVDRPCommandIcon(Option,ReplyCode);
+  } else if(!strcasecmp(Command, "BENCH")) {
+    szReplay = SVDRPCommandBench(Option,ReplyCode);
+  } else if(!strcasecmp(Command, "STAT")) {
+    szReplay = SVDRPCommandStat(Option,ReplyCode);
+  } else if(!strcasecmp(Command, "SESSION")) {
+    szReplay = SVDRPCommandSession(Option,ReplyCode);
   } 
 
-  dsyslog("iMonLCD: SVDRP %s %s - %d (%s)", Command, Option, ReplyCode, szReplay);
+  dsyslog("iMonLCD: SVDRP %s %s - %d (%s)", Command, Option, ReplyCode, *szReplay);
   return szReplay;
 }
 
@@ -435,6 +554,15 @@ const char **cPluginImonlcd::SVDRPHelpPages(void)
     "    Suspend driver of display.\n",
     "ICON [name] [on|off|auto]\n"
     "    Force state of icon.\n",
+    "BENCH [frames]\n"
+    "    Render and write frames as fast as possible (default 100),\n"
+    "    report frames/s, bytes/frame and write latency.\n",
+    "STAT [reset]\n"
+    "    Report counters of rendering and writing, or reset them.\n",
+    "SESSION [cycles]\n"
+    "    Play a scripted session of live TV, menus and replay (default 3\n"
+    "    cycles), fail if the display loop allocates after the first one.\n"
+    "    Writing the metrics file (-m) isn't counted.\n",
     NULL
     };
   if(m_szIconHelpPage)
@@ -0,0 +1,104 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <vdr/tools.h>
+#include "ffont.h"
+#include "marquee.h"
+
+/* limit memory usage of very long text */
+#define MARQUEE_MAX_WIDTH 8192
+
+ciMonMarquee::ciMonMarquee()
+{
+  strip = NULL;
+  font = NULL;
+  top = 0;
+  textWidth = 0;
+}
+
+ciMonMarquee::~ciMonMarquee()
+{
+  if(strip)
+    delete strip;
+}
+
+/**
+ * Drop the rasterized text, e.g. after the font was changed.
+ * Memory of the strip is kept for the next text.
+ */
+void ciMonMarquee::Clear()
+{
+  font = NULL;
+  text.Clear();
+  textWidth = 0;
+}
+
+/**
+ * Rasterize the text into the strip, if it's not already done.
+ * \param pFont    Font to render the text.
+ * \param y        Vertical position of the text at the display.
+ * \param nHeight  Height of the display.
+ * \param szText   Text to render.
+ */
+bool ciMonMarquee::Prepare(const ciMonFont* pFont, int y, int nHeight, const char* szText)
+{
+  if(!pFont || !szText)
+    return false;
+
+  if(font == pFont
+     && top == y
+     && strip->Height() == nHeight
+     && 0 == strcmp(text, szText)) {
+    return true; // already rendered
+  }
+
+  Clear();
+
+  textWidth = pFont->Width(szText);
+  // let some space for glyphs, which exceed their advance width
+  int nWidth = min(textWidth + pFont->Height(), MARQUEE_MAX_WIDTH);
+  if(textWidth > nWidth)
+    textWidth = nWidth;
+  if(nWidth <= 0)
+    return false;
+
+  if(!strip)
+    strip = new ciMonBitmap(nWidth, nHeight);
+  else
+    strip->Resize(nWidth, nHeight);
+  if(!strip->getBitmap()) {
+    Clear();
+    return false;
+  }
+  pFont->DrawText(strip, 0, y, szText, nWidth);
+
+  font = pFont;
+  top = y;
+  text.Set(szText);
+  return true;
+}
+
+/**
+ * Copy a window of the rasterized text into the bitmap.
+ * \param pBitmap  Target bitmap, with same height as the strip.
+ * \param nOffset  Horizontal scroll offset.
+ * \return 1 if more text follows at the right side, 0 if the text end is visible.
+ */
+int ciMonMarquee::Draw(ciMonBitmap* pBitmap, int nOffset) const
+{
+  if(!font || !pBitmap)
+    return -1;
+
+  pBitmap->Blit(*strip, nOffset);
+  return (nOffset + pBitmap->Width() < textWidth) ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_MARQUEE_H___
+#define __IMON_MARQUEE_H___
+
+#include <vdr/tools.h>
+#include "bitmap.h"
+#include "text.h"
+
+class ciMonFont;
+
+/**
+ * Scroll engine for text, which is wider than the display.
+ * The text is rasterized once into a wide off-screen strip, each
+ * frame only copies a window of this strip into the frame buffer.
+ */
+class ciMonMarquee {
+  ciMonBitmap*     strip;  ///< kept for next text, grows with longest text
+  const ciMonFont* font;   ///< NULL, if strip doesn't hold a text
+  ciMonText        text;
+  int              top;
+  int              textWidth;
+public:
+  ciMonMarquee();
+  virtual ~ciMonMarquee();
+
+  void Clear();
+  bool Prepare(const ciMonFont* pFont, int y, int nHeight, const char* szText);
+  int Draw(ciMonBitmap* pBitmap, int nOffset) const;
+  int TextWidth() const { return textWidth; }
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <string.h>
+#include <ctype.h>
+
+#include <vdr/tools.h>
+#include "replay.h"
+#include "setup.h"
+
+/// mp3/muggle plugin : [LS] (444/666) title
+static bool MatchMusic(const char *Name, int Length, ciMonReplayInfo &Info)
+{
+  if(Length <= 6 || Name[0] != '[' || Name[3] != ']' || Name[5] != '(')
+    return false;
+  for(int i = 6; i < Length; ++i) {
+    if(Name[i] == ' ' && Name[i - 1] == ')') {
+      // get loopmode
+      if(Name[1] != '.' && Name[2] != '.')
+        Info.replayMode = eReplayModeRepeatShuffle;
+      else if(Name[1] != '.')
+        Info.replayMode = eReplayModeRepeat;
+      else if(Name[2] != '.')
+        Info.replayMode = eReplayModeShuffle;
+      Info.title = i;
+      Info.watchMode = eReplayMusic;
+      Info.videoMode = eVideoNone;
+      Info.audioMode = eAudioMP3;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// DVD plugin : 1/8 4/28,  de 2/5 ac3, no 0/7,  16:9, VOLUMENAME
+/// cDvdPlayerControl::GetDisplayHeaderLine : titleinfo, audiolang, spulang, aspect, title
+static bool MatchDVD(const char *Name, int Length, ciMonReplayInfo &Info)
+{
+  if(Length <= 7)
+    return false;
+  for(int i = 1, n = 0; i < Length; ++i) {
+    if(Name[i] == ' ' && Name[i - 1] == ',' && ++n == 4) {
+      Info.title = i;
+      Info.watchMode = eReplayDVD;
+      Info.videoMode = eVideoMPG;
+      Info.audioMode = eAudioMPG;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// recordings : directory~subtitle~title, players of files : /path/file.ext
+static bool MatchPath(const char *Name, int Length, ciMonReplayInfo &Info)
+{
+  // look for file extentsion like .xxx or .xxxx
+  bool bIsFile = Length > 5 && (Name[Length - 4] == '.' || Name[Length - 5] == '.');
+  for(int i = Length - 1; i > 0; --i) {
+    if(Name[i] == '~' || (bIsFile && Name[i] == '/')) {
+      if(Name[i] == '/')
+        Info.watchMode = eReplayFile;
+      Info.title = i + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// image plugin : [image] title
+static bool MatchImage(const char *Name, int Length, ciMonReplayInfo &Info)
+{
+  if(strncmp(Name, "[image] ", 8))
+    return false;
+  if(Info.watchMode != eReplayFile) // if'nt already stripped-down as filename
+    Info.title = 8;
+  Info.watchMode = eReplayImage;
+  Info.videoMode = eVideoMPG;
+  Info.audioMode = eAudioNone;
+  return true;
+}
+
+/// audio cd : [audiocd] title
+static bool MatchAudioCD(const char *Name, int Length, ciMonReplayInfo &Info)
+{
+  if(strncmp(Name, "[audiocd] ", 10))
+    return false;
+  Info.title = 10;
+  Info.watchMode = eReplayAudioCD;
+  Info.videoMode = eVideoNone;
+  Info.audioMode = eAudioWAV;
+  return true;
+}
+
+/**
+ * Known kinds of replay names, new players are added here.
+ */
+static const ciMonReplayRecognizer recognizers[] = {
+  { "music",   eMatchTitle,  MatchMusic },
+  { "dvd",     eMatchTitle,  MatchDVD },
+  { "path",    eMatchTitle,  MatchPath },
+  { "image",   eMatchPrefix, MatchImage },
+  { "audiocd", eMatchPrefix, MatchAudioCD },
+};
+
+const ciMonReplayRecognizer *ciMonReplayClassifier::Recognizers(int &Count)
+{
+  Count = memberof(recognizers);
+  return recognizers;
+}
+
+/**
+ * Classify a name without blanks at begin and end, it doesn't keep any state.
+ */
+void ciMonReplayClassifier::Parse(const char *Name, ciMonReplayInfo &Info)
+{
+  Info.watchMode = eReplayNormal;
+  Info.videoMode = eVideoMPG;
+  Info.audioMode = eAudioMPG;
+  Info.replayMode = eReplayModeNormal;
+  Info.title = -1;
+
+  int nLength = strlen(Name);
+  bool bPrefix = false;
+  for(unsigned int n = 0; n < memberof(recognizers); ++n) {
+    const ciMonReplayRecognizer &r = recognizers[n];
+    switch(r.kind) {
+      case eMatchTitle:
+        if(Info.title < 0)
+          r.match(Name, nLength, Info);
+        break;
+      case eMatchPrefix:
+        if(!bPrefix)
+          bPrefix = r.match(Name, nLength, Info);
+        break;
+    }
+  }
+}
+
+ciMonReplayClassifier::ciMonReplayClassifier()
+{
+  m_pControl = NULL;
+  m_szName[0] = '\0';
+  m_bValid = false;
+  Parse(m_szName, m_Info);
+}
+
+/**
+ * Classify the name of a replay, the result of the last call is reused.
+ * \param Control Identity of the replay control, isn't used otherwise.
+ */
+const ciMonReplayInfo& ciMonReplayClassifier::Classify(const void *Control, const char *Name)
+{
+  bool bChanged = m_sRawName.Set(Name);
+  if(m_bValid && !bChanged && Control == m_pControl)
+    return m_Info;
+
+  m_pControl = Control;
+  m_bValid = true;
+
+  // without blanks, '~' and '\' at begin and end
+  strn0cpy(m_szName, skipspace(m_sRawName), sizeof(m_szName));
+  for(char *p = m_szName + strlen(m_szName) - 1; p >= m_szName; --p) {
+    if(isspace(*p) || *p == '~' || *p == '\\')
+      *p = '\0';
+    else
+      break;
+  }
+  Parse(m_szName, m_Info);
+  return m_Info;
+}
+
+/**
+ * Title of last classified name, empty if there is none.
+ */
+const char *ciMonReplayClassifier::Title() const
+{
+  return skipspace(m_szName + (m_Info.title < 0 ? 0 : m_Info.title));
+}
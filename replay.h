@@ -0,0 +1,111 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_REPLAY_H
+#define __IMON_REPLAY_H
+
+#include "text.h"
+
+enum eWatchMode {
+    eUndefined,
+    eLiveTV,
+    eReplayNormal,
+    eReplayMusic,
+    eReplayDVD,
+    eReplayFile,
+    eReplayImage,
+    eReplayAudioCD
+};
+
+enum eReplayMode {
+    eReplayModeNormal,
+  	eReplayModeShuffle,
+  	eReplayModeRepeat,
+  	eReplayModeRepeatShuffle,
+};
+
+enum eVideoMode {
+    eVideoNone,
+    eVideoMPG,
+    eVideoDivX,
+    eVideoXviD,
+    eVideoWMV
+};
+
+enum eAudioMode {
+    eAudioNone  = 0,
+    eAudioMPG   = 1 << 0,
+    eAudioAC3   = 1 << 1,
+    eAudioDTS   = 1 << 2,
+    eAudioWMA   = 1 << 3,
+    eAudioMP3   = 1 << 4,
+    eAudioOGG   = 1 << 5,
+    eAudioWAV   = 1 << 6
+};
+
+/**
+ * What a replay name tells about the player and its title.
+ */
+struct ciMonReplayInfo {
+  eWatchMode  watchMode;
+  eVideoMode  videoMode;
+  int         audioMode;    ///< combination of eAudioMode
+  eReplayMode replayMode;
+  int         title;        ///< start of title in the name, -1 for whole name
+};
+
+/**
+ * Recognizer of one kind of replay names, see ciMonReplayClassifier.
+ * \param Name   Name without blanks at begin and end.
+ * \param Length Length of name.
+ * \param Info   Result of previous recognizers, to be completed.
+ * \return true, if the name was recognized.
+ */
+typedef bool (*tReplayMatcher)(const char *Name, int Length, ciMonReplayInfo &Info);
+
+enum eReplayMatch {
+  eMatchTitle,   ///< used only, if no previous recognizer has found a title
+  eMatchPrefix   ///< used always, until one prefix was recognized
+};
+
+struct ciMonReplayRecognizer {
+  const char     *name;
+  eReplayMatch    kind;
+  tReplayMatcher  match;
+};
+
+/**
+ * Classify the names given by players with cStatus::Replaying(), like
+ * "[LS] (3/12) title" of the mp3 plugin or "1/8 4/28, de 2/5 ac3, ..."
+ * of the DVD plugin. Recognizers are tried in the order of a table.
+ * The result of the last name of a control is kept, so repeated calls
+ * with the same name aren't parsed again.
+ */
+class ciMonReplayClassifier {
+private:
+  const void     *m_pControl;   ///< control of cached result, only compared
+  ciMonText       m_sRawName;
+  char            m_szName[TEXT_SIZE];
+  ciMonReplayInfo m_Info;
+  bool            m_bValid;
+public:
+  ciMonReplayClassifier();
+
+  const ciMonReplayInfo& Classify(const void *Control, const char *Name);
+  const char *Title() const;
+
+  static void Parse(const char *Name, ciMonReplayInfo &Info);
+  static const ciMonReplayRecognizer *Recognizers(int &Count);
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <vdr/device.h>
+#include <vdr/tools.h>
+
+#include "session.h"
+#include "watch.h"
+#include "setup.h"
+#include "stats.h"
+
+#define SESSION_LENGTH 360000  ///< frames of scripted recording, four hours
+
+/*
+ * Script of one cycle, with texts longer than the display, so they scroll.
+ */
+static const ciMonSessionStep script[] = {
+  { eStepLive,      0, 2000, NULL },
+  { eStepMenu,      0, 2500, "Schedule - What's on now? A title longer than the display" },
+  { eStepMessage,   0,  500, "Channel not available, because it is scrambled" },
+  { eStepVolume,    0,  500, NULL },
+  { eStepAudio,     0,  500, NULL },
+  { eStepRecording, 0,  500, "Recording of a documentary with a long name" },
+  { eStepReplay,    0, 2500, "~Documentaries~A replay with a name longer than the display" },
+  { eStepForward,   1,  700, NULL },
+  { eStepForward,   3,  700, NULL },
+  { eStepBackward,  2,  700, NULL },
+  { eStepPause,     0,  700, NULL },
+  { eStepStop,      0,  500, NULL },
+  { eStepReplay,    0, 1500, "[music] Artist - Title of a song" },
+  { eStepStop,      0,  500, NULL }
+};
+
+ciMonSessionControl::ciMonSessionControl()
+: cControl(NULL, true)
+, m_nStart(0)
+, m_nStartIndex(0)
+{
+  Mode(true, true, -1);
+}
+
+/// Position of player, about as fast as replay of VDR.
+int ciMonSessionControl::Index() const
+{
+  int nFactor = m_bPlay ? (m_nSpeed > 0 ? (1 << (m_nSpeed + 1)) : 1) : 0;
+  if(!m_bForward)
+    nFactor = -nFactor;
+  int64_t n = m_nStartIndex
+            + (int64_t)(cTimeMs::Now() - m_nStart) * nFactor * (int)DEFAULTFRAMESPERSECOND / 1000;
+  if(n < 0)
+    n = 0;
+  if(n > SESSION_LENGTH)
+    n = SESSION_LENGTH;
+  return (int)n;
+}
+
+#if APIVERSNUM >= 20302
+bool ciMonSessionControl::GetIndex(int &Current, int &Total, bool SnapToIFrame) const
+#else
+bool ciMonSessionControl::GetIndex(int &Current, int &Total, bool SnapToIFrame)
+#endif
+{
+  Current = Index();
+  Total = SESSION_LENGTH;
+  return true;
+}
+
+#if APIVERSNUM >= 20302
+bool ciMonSessionControl::GetReplayMode(bool &Play, bool &Forward, int &Speed) const
+#else
+bool ciMonSessionControl::GetReplayMode(bool &Play, bool &Forward, int &Speed)
+#endif
+{
+  Play = m_bPlay;
+  Forward = m_bForward;
+  Speed = m_nSpeed;
+  return true;
+}
+
+/**
+ * Change mode of player, the position continues from where it is.
+ */
+void ciMonSessionControl::Mode(bool bPlay, bool bForward, int nSpeed)
+{
+  m_nStartIndex = m_nStart ? Index() : 0;
+  m_nStart = cTimeMs::Now();
+  m_bPlay = bPlay;
+  m_bForward = bForward;
+  m_nSpeed = nSpeed;
+}
+
+ciMonSession::ciMonSession(ciMonWatch &Dev)
+: m_Dev(Dev)
+, m_bReplay(false)
+{
+}
+
+/**
+ * Milliseconds of one cycle of the script.
+ */
+int ciMonSession::Duration()
+{
+  int n = 0;
+  for(unsigned int i = 0; i < memberof(script); ++i)
+    n += script[i].duration;
+  return n;
+}
+
+void ciMonSession::Play(const ciMonSessionStep &s)
+{
+  cDevice *pDevice = cDevice::PrimaryDevice();
+  switch(s.step) {
+    case eStepLive:
+      m_Dev.Channel(cDevice::CurrentChannel());
+      break;
+    case eStepMenu:
+      m_Dev.OsdClear();
+      m_Dev.OsdTitle(s.text);
+      m_Dev.OsdCurrentItem("20:15 Feature film of the evening, with a subtitle longer than the display");
+      break;
+    case eStepMessage:
+      m_Dev.OsdStatusMessage(s.text);
+      cCondWait::SleepMs(s.duration / 2);
+      m_Dev.OsdStatusMessage(NULL);
+      m_Dev.OsdClear();
+      break;
+    case eStepVolume:
+      m_Dev.Volume(0, true);
+      cCondWait::SleepMs(s.duration / 2);
+      m_Dev.Volume(cDevice::CurrentVolume(), true);
+      break;
+    case eStepAudio:
+      m_Dev.AudioTrack(ttDolbyFirst, 0);
+      cCondWait::SleepMs(s.duration / 2);
+      if(pDevice)
+        m_Dev.AudioTrack(pDevice->GetCurrentAudioTrack(), pDevice->GetAudioChannel());
+      break;
+    case eStepRecording:
+      if(pDevice) {
+        m_Dev.Recording(pDevice, s.text, NULL, true);
+        cCondWait::SleepMs(s.duration / 2);
+        m_Dev.Recording(pDevice, s.text, NULL, false);
+      }
+      break;
+    case eStepReplay:
+      m_Control.Mode(true, true, -1);
+      m_Dev.Replaying(&m_Control, s.text, NULL, true);
+      m_bReplay = true;
+      break;
+    case eStepForward:
+      m_Control.Mode(true, true, s.value);
+      m_Dev.OsdClear(); // like a key press
+      break;
+    case eStepBackward:
+      m_Control.Mode(true, false, s.value);
+      m_Dev.OsdClear();
+      break;
+    case eStepPause:
+      m_Control.Mode(false, true, -1);
+      m_Dev.OsdClear();
+      break;
+    case eStepStop:
+      m_Dev.Replaying(&m_Control, NULL, NULL, false);
+      m_bReplay = false;
+      break;
+  }
+}
+
+/**
+ * Play the script, while the watch thread is running.
+ * \param nCycles  Cycles of the script, the first one is warm-up.
+ */
+void ciMonSession::Run(int nCycles, ciMonSessionResult &result)
+{
+  result.cycles = 0;
+  result.iterations = 0;
+  result.allocations = 0;
+  result.loopsAllocating = 0;
+  dsyslog("iMonLCD: scripted session of %d cycles, %d s", nCycles, nCycles * Duration() / 1000);
+
+  uint64_t nIterations = 0;
+  uint64_t nAllocations = 0;
+  uint64_t nLoopsAllocating = 0;
+  for(int nCycle = 0; nCycle < nCycles; ++nCycle) {
+    if(nCycle == 1) {
+      nIterations = theStats.loopIterations;
+      nAllocations = theStats.loopAllocations;
+      nLoopsAllocating = theStats.loopsAllocating;
+    }
+    for(unsigned int i = 0; i < memberof(script); ++i) {
+      const ciMonSessionStep &s = script[i];
+      Play(s);
+      cCondWait::SleepMs(s.duration);
+    }
+  }
+  if(m_bReplay)
+    m_Dev.Replaying(&m_Control, NULL, NULL, false);
+  // back to state of VDR
+  m_Dev.OsdClear();
+  m_Dev.Channel(cDevice::CurrentChannel());
+
+  if(nCycles > 1) {
+    result.cycles = nCycles - 1;
+    result.iterations = theStats.loopIterations - nIterations;
+    result.allocations = theStats.loopAllocations - nAllocations;
+    result.loopsAllocating = theStats.loopsAllocating - nLoopsAllocating;
+  }
+}
@@ -0,0 +1,94 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_SESSION_H
+#define __IMON_SESSION_H
+
+#include <stdint.h>
+#include <vdr/player.h>
+
+class ciMonWatch;
+
+enum eSessionStep {
+  eStepLive,      ///< live TV of current channel
+  eStepMenu,      ///< text: title of menu, item is longer than display
+  eStepMessage,   ///< text: status message
+  eStepVolume,    ///< mute and restore volume
+  eStepAudio,     ///< switch to dolby and back
+  eStepRecording, ///< text: name, recording starts and stops on primary device
+  eStepReplay,    ///< text: name of replay
+  eStepForward,   ///< value: speed 1..3
+  eStepBackward,  ///< value: speed 1..3
+  eStepPause,
+  eStepStop
+};
+
+/**
+ * One step of a scripted session, the display runs for its duration.
+ */
+struct ciMonSessionStep {
+  eSessionStep step;
+  int          value;
+  int          duration;  ///< milliseconds
+  const char  *text;
+};
+
+struct ciMonSessionResult {
+  int      cycles;          ///< cycles after warm-up
+  uint64_t iterations;      ///< passes of watch thread after warm-up
+  uint64_t allocations;     ///< heap allocations of watch thread after warm-up
+  uint64_t loopsAllocating; ///< passes with heap allocations after warm-up
+};
+
+/**
+ * Player of a scripted session, position grows with time and speed.
+ */
+class ciMonSessionControl : public cControl {
+private:
+  uint64_t m_nStart;         ///< time of last change of mode
+  int      m_nStartIndex;    ///< position at m_nStart
+  volatile bool m_bPlay;
+  volatile bool m_bForward;
+  volatile int  m_nSpeed;    ///< -1 normal speed, 1..3 fast
+  int Index() const;
+public:
+  ciMonSessionControl();
+  virtual void Hide(void) {}
+#if APIVERSNUM >= 20302
+  virtual bool GetIndex(int &Current, int &Total, bool SnapToIFrame = false) const;
+  virtual bool GetReplayMode(bool &Play, bool &Forward, int &Speed) const;
+#else
+  virtual bool GetIndex(int &Current, int &Total, bool SnapToIFrame = false);
+  virtual bool GetReplayMode(bool &Play, bool &Forward, int &Speed);
+#endif
+  void Mode(bool bPlay, bool bForward, int nSpeed);
+};
+
+/**
+ * Drive the display like a user, by the same calls as the status monitor.
+ * The first cycle warms up fonts and texts, allocations of the watch thread
+ * are counted for all further cycles.
+ */
+class ciMonSession {
+private:
+  ciMonWatch&         m_Dev;
+  ciMonSessionControl m_Control;
+  bool                m_bReplay;
+  void Play(const ciMonSessionStep &s);
+public:
+  ciMonSession(ciMonWatch &Dev);
+  void Run(int nCycles, ciMonSessionResult &result);
+  static int Duration();
+};
+
+#endif
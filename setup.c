@@ -26,6 +26,7 @@
 #define DEFAULT_ON_EXIT      eOnExitMode_BLANKSCREEN	/**< Blank the device completely */
 #define DEFAULT_CONTRAST     200
 #define DEFAULT_DISCMODE     1	/**< spin the "slim" disc */
+#define DEFAULT_DISCSPIN     400	/**< milliseconds per frame of spinning disc */
 #define DEFAULT_WIDTH        96
 #define DEFAULT_HEIGHT       16
 #define DEFAULT_FONT         "Sans:Bold"
@@ -44,6 +45,7 @@ cIMonSetup::cIMonSetup(void)
   m_nOnExit = DEFAULT_ON_EXIT;
   m_nContrast = DEFAULT_CONTRAST;
   m_bDiscMode = DEFAULT_DISCMODE;
+  m_nDiscSpin = DEFAULT_DISCSPIN;
 
   m_nWidth = DEFAULT_WIDTH;
   m_nHeight = DEFAULT_HEIGHT;
@@ -69,6 +71,7 @@ cIMonSetup& cIMonSetup::operator = (const cIMonSetup& x)
   m_nOnExit = x.m_nOnExit;
   m_nContrast = x.m_nContrast;
   m_bDiscMode = x.m_bDiscMode;
+  m_nDiscSpin = x.m_nDiscSpin;
 
   m_nWidth = x.m_nWidth;
   m_nHeight = x.m_nHeight;
@@ -156,6 +159,17 @@ bool cIMonSetup::SetupParse(const char *szName, const char *szValue)
     m_bDiscMode = atoi(szValue) == 0?0:1;
     return true;
   }
+  // DiscSpin
+  if(!strcasecmp(szName, "DiscSpin")) {
+    int n = atoi(szValue);
+    if ((n < 50) || (n > 2000)) {
+		    esyslog("iMonLCD: DiscSpin must be between 50 and 2000, using default %d",
+		           DEFAULT_DISCSPIN);
+		    n = DEFAULT_DISCSPIN;
+    }
+    m_nDiscSpin = n;
+    return true;
+  }
 
   // Wakeup
   if(!strcasecmp(szName, "Wakeup")) {
@@ -252,6 +266,7 @@ void ciMonMenuSetup::Store(void)
   SetupStore("OnExit",     theSetup.m_nOnExit);
   SetupStore("Contrast",   theSetup.m_nContrast);
   SetupStore("DiscMode",   theSetup.m_bDiscMode);
+  SetupStore("DiscSpin",   theSetup.m_nDiscSpin);
   SetupStore("Font",       theSetup.m_szFont);
   SetupStore("BigFont",    theSetup.m_nBigFontHeight);
   SetupStore("SmallFont",  theSetup.m_nSmallFontHeight);
@@ -288,6 +303,9 @@ ciMonMenuSetup::ciMonMenuSetup(ciMonWatch*    pDev)
   Add(new cMenuEditBoolItem(tr("Disc spinning mode"),                    
         &m_tmpSetup.m_bDiscMode,    
         tr("Slim disc"), tr("Full disc")));
+  Add(new cMenuEditIntItem (tr("Disc spinning frame time (ms)"),
+        &m_tmpSetup.m_nDiscSpin,
+        50, 2000));
 
   static const char * szRenderMode[3];
   szRenderMode[eRenderMode_SingleLine] = tr("Single line");
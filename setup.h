@@ -45,6 +45,7 @@ struct cIMonSetup
   int          m_nOnExit;
   int          m_nContrast;
 	int          m_bDiscMode;
+  int          m_nDiscSpin;   /** milliseconds per frame of spinning disc at normal playback */
 
   int          m_nWidth;
   int          m_nHeight;
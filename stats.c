@@ -0,0 +1,242 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include "stats.h"
+
+ciMonStats theStats;
+
+ciMonHistogram::ciMonHistogram()
+{
+  Reset();
+}
+
+void ciMonHistogram::Reset()
+{
+  for(int n = 0; n < STATS_BUCKETS; ++n)
+    bucket[n] = 0;
+  count = 0;
+  sum = 0;
+}
+
+void ciMonHistogram::Add(uint64_t nUs)
+{
+  int n = 0;
+  while(n < STATS_BUCKETS - 1 && nUs > Limit(n))
+    ++n;
+  __sync_fetch_and_add(&bucket[n], 1);
+  __sync_fetch_and_add(&count, 1);
+  __sync_fetch_and_add(&sum, nUs);
+}
+
+/**
+ * Upper limit of the bucket, which holds the given percentile.
+ */
+uint64_t ciMonHistogram::Percentile(int nPercent) const
+{
+  uint64_t nTotal = 0;
+  for(int n = 0; n < STATS_BUCKETS; ++n)
+    nTotal += bucket[n];
+  if(!nTotal)
+    return 0;
+  uint64_t nNeed = (nTotal * nPercent + 99) / 100;
+  uint64_t nSeen = 0;
+  for(int n = 0; n < STATS_BUCKETS; ++n) {
+    nSeen += bucket[n];
+    if(nSeen >= nNeed)
+      return Limit(n);
+  }
+  return Limit(STATS_BUCKETS - 1);
+}
+
+ciMonStats::ciMonStats()
+{
+  suspended = 1;
+  Reset();
+}
+
+void ciMonStats::Reset()
+{
+  framesRendered = 0;
+  framesFlushed = 0;
+  framesSkipped = 0;
+  packetsPosted = 0;
+  packetsWritten = 0;
+  bytesWritten = 0;
+  writeErrors = 0;
+  commands = 0;
+  iconCommands = 0;
+  barCommands = 0;
+  loopIterations = 0;
+  glyphHits = 0;
+  glyphMisses = 0;
+  openErrors = 0;
+  events = 0;
+  eventsDropped = 0;
+  playerQueries = 0;
+  loopAllocations = 0;
+  loopsAllocating = 0;
+  tickDuration.Reset();
+  flushDuration.Reset();
+  writeLatency.Reset();
+}
+
+typedef void (*tAllocCount)(unsigned long long *pMallocs, unsigned long long *pFrees);
+
+/// Counter of tools/libimonlcd-alloc.so, NULL if it isn't preloaded.
+static tAllocCount AllocCount()
+{
+  static tAllocCount f = (tAllocCount)dlsym(RTLD_DEFAULT, "imonlcd_alloc_count");
+  return f;
+}
+
+bool ciMonStats::CountsAllocations()
+{
+  return AllocCount() != NULL;
+}
+
+/**
+ * Heap allocations of the calling thread, 0 if they aren't counted.
+ */
+uint64_t ciMonStats::Allocations()
+{
+  tAllocCount f = AllocCount();
+  if(!f)
+    return 0;
+  unsigned long long nMallocs = 0;
+  f(&nMallocs, NULL);
+  return nMallocs;
+}
+
+/**
+ * Counters as text, one per line.
+ */
+cString ciMonStats::Report() const
+{
+  uint64_t nLookups = glyphHits + glyphMisses;
+  return cString::sprintf(
+    "frames rendered %llu, flushed %llu, unchanged %llu\n"
+    "packets posted %llu, written %llu, bytes %llu, write errors %llu\n"
+    "commands %llu, icon commands %llu, progress bar commands %llu\n"
+    "status events %llu, dropped %llu, player queries %llu\n"
+    "loop iterations %llu, tick avg %llu us, p99 <= %llu us\n"
+    "%s\n"
+    "flush avg %llu us, p99 <= %llu us\n"
+    "write latency avg %llu us, p99 <= %llu us\n"
+    "glyph cache hits %llu, misses %llu, hit rate %.1f%%",
+    (unsigned long long)framesRendered,
+    (unsigned long long)framesFlushed,
+    (unsigned long long)framesSkipped,
+    (unsigned long long)packetsPosted,
+    (unsigned long long)packetsWritten,
+    (unsigned long long)bytesWritten,
+    (unsigned long long)writeErrors,
+    (unsigned long long)commands,
+    (unsigned long long)iconCommands,
+    (unsigned long long)barCommands,
+    (unsigned long long)events,
+    (unsigned long long)eventsDropped,
+    (unsigned long long)playerQueries,
+    (unsigned long long)loopIterations,
+    (unsigned long long)tickDuration.Average(),
+    (unsigned long long)tickDuration.Percentile(99),
+    CountsAllocations()
+      ? *cString::sprintf("loop allocations %llu, iterations with allocations %llu",
+                          (unsigned long long)loopAllocations, (unsigned long long)loopsAllocating)
+      : "loop allocations not counted",
+    (unsigned long long)flushDuration.Average(),
+    (unsigned long long)flushDuration.Percentile(99),
+    (unsigned long long)writeLatency.Average(),
+    (unsigned long long)writeLatency.Percentile(99),
+    (unsigned long long)glyphHits,
+    (unsigned long long)glyphMisses,
+    nLookups ? 100.0 * glyphHits / nLookups : 0.0);
+}
+
+static void WriteCounter(FILE *f, const char *szName, const char *szHelp, uint64_t nValue)
+{
+  fprintf(f, "# HELP imonlcd_%s %s\n", szName, szHelp);
+  fprintf(f, "# TYPE imonlcd_%s counter\n", szName);
+  fprintf(f, "imonlcd_%s %llu\n", szName, (unsigned long long)nValue);
+}
+
+static void WriteHistogram(FILE *f, const char *szName, const char *szHelp, const ciMonHistogram& h)
+{
+  fprintf(f, "# HELP imonlcd_%s %s\n", szName, szHelp);
+  fprintf(f, "# TYPE imonlcd_%s histogram\n", szName);
+  uint64_t nCount = 0;
+  for(int n = 0; n < METRICS_BUCKETS; ++n) {
+    nCount += h.Bucket(n);
+    fprintf(f, "imonlcd_%s_bucket{le=\"%g\"} %llu\n", szName,
+            ciMonHistogram::Limit(n) / 1000000.0, (unsigned long long)nCount);
+  }
+  for(int n = METRICS_BUCKETS; n < STATS_BUCKETS; ++n)
+    nCount += h.Bucket(n);
+  fprintf(f, "imonlcd_%s_bucket{le=\"+Inf\"} %llu\n", szName, (unsigned long long)nCount);
+  fprintf(f, "imonlcd_%s_sum %.6f\n", szName, h.Sum() / 1000000.0);
+  fprintf(f, "imonlcd_%s_count %llu\n", szName, (unsigned long long)nCount);
+}
+
+/**
+ * Write all counters in text format of Prometheus, e.g. for the
+ * textfile collector of node_exporter. The file is replaced atomically.
+ */
+bool ciMonStats::WriteMetrics(const char *szFileName) const
+{
+  cString sTmp = cString::sprintf("%s.%d", szFileName, getpid());
+  FILE *f = fopen(sTmp, "w");
+  if(!f) {
+    esyslog("iMonLCD: unable to write metrics %s (%s)", *sTmp, strerror(errno));
+    return false;
+  }
+
+  WriteCounter(f, "frames_rendered_total", "Screen contents drawn.", framesRendered);
+  WriteCounter(f, "frames_flushed_total", "Frames with changed contents sent to display.", framesFlushed);
+  WriteCounter(f, "frames_unchanged_total", "Frames skipped, because contents was unchanged.", framesSkipped);
+  WriteCounter(f, "packets_written_total", "Packets written to device.", packetsWritten);
+  WriteCounter(f, "bytes_written_total", "Bytes written to device.", bytesWritten);
+  WriteCounter(f, "write_errors_total", "Failed writes to device.", writeErrors);
+  WriteCounter(f, "open_errors_total", "Failed attempts to open device.", openErrors);
+  WriteCounter(f, "events_total", "Status changes queued for watch thread.", events);
+  WriteCounter(f, "events_dropped_total", "Status changes lost, because queue was full.", eventsDropped);
+  WriteCounter(f, "player_queries_total", "Calls into player for replay mode and position.", playerQueries);
+  WriteCounter(f, "loop_iterations_total", "Iterations of watch thread.", loopIterations);
+  if(CountsAllocations()) {
+    WriteCounter(f, "loop_allocations_total", "Heap allocations of watch thread.", loopAllocations);
+    WriteCounter(f, "loops_allocating_total", "Iterations of watch thread, which allocated.", loopsAllocating);
+  }
+  WriteCounter(f, "glyph_cache_hits_total", "Glyphs found in cache.", glyphHits);
+  WriteCounter(f, "glyph_cache_misses_total", "Glyphs not found in cache.", glyphMisses);
+  fprintf(f, "# HELP imonlcd_suspended Display is suspended or turned off.\n");
+  fprintf(f, "# TYPE imonlcd_suspended gauge\n");
+  fprintf(f, "imonlcd_suspended %d\n", suspended ? 1 : 0);
+  WriteHistogram(f, "tick_duration_seconds", "Work of one iteration of watch thread.", tickDuration);
+  WriteHistogram(f, "flush_duration_seconds", "Duration of flush of changed frame.", flushDuration);
+  WriteHistogram(f, "write_latency_seconds", "Time spent in write() to device.", writeLatency);
+
+  bool bOk = !ferror(f);
+  if(fclose(f) != 0)
+    bOk = false;
+  if(bOk && rename(sTmp, szFileName) < 0)
+    bOk = false;
+  if(!bOk) {
+    esyslog("iMonLCD: unable to write metrics %s (%s)", szFileName, strerror(errno));
+    unlink(sTmp);
+  }
+  return bOk;
+}
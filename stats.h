@@ -0,0 +1,86 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_STATS_H
+#define __IMON_STATS_H
+
+#include <stdint.h>
+#include <vdr/tools.h>
+
+#define STATS_BUCKETS 32  ///< log2 buckets of microseconds, last one is open
+#define METRICS_BUCKETS 24 ///< exported buckets, up to 2^23 us
+#define METRICS_INTERVAL 15000 ///< milliseconds between updates of metrics file
+
+/**
+ * Distribution of durations, bucket n counts values up to 2^n microseconds.
+ */
+class ciMonHistogram {
+private:
+  volatile uint64_t bucket[STATS_BUCKETS];
+  volatile uint64_t count;
+  volatile uint64_t sum;
+public:
+  ciMonHistogram();
+  void Add(uint64_t nUs);
+  void Reset();
+  uint64_t Count() const { return count; }
+  uint64_t Sum() const { return sum; }
+  uint64_t Average() const { return count ? sum / count : 0; }
+  uint64_t Percentile(int nPercent) const;
+  uint64_t Bucket(int n) const { return bucket[n]; }
+  static uint64_t Limit(int n) { return (uint64_t)1 << n; }
+};
+
+/**
+ * Counters of display thread, writer and renderer.
+ * All updates are atomic without lock, so they are always enabled.
+ */
+class ciMonStats {
+public:
+  volatile uint64_t framesRendered;  ///< screen contents drawn
+  volatile uint64_t framesFlushed;   ///< frames with changed contents, send to display
+  volatile uint64_t framesSkipped;   ///< frames without changes
+  volatile uint64_t packetsPosted;   ///< display packets handed to writer
+  volatile uint64_t packetsWritten;
+  volatile uint64_t bytesWritten;
+  volatile uint64_t writeErrors;
+  volatile uint64_t commands;        ///< ordered commands (init, shutdown, clock)
+  volatile uint64_t iconCommands;
+  volatile uint64_t barCommands;
+  volatile uint64_t loopIterations;
+  volatile uint64_t glyphHits;
+  volatile uint64_t glyphMisses;
+  volatile uint64_t openErrors;      ///< failed attempts to open and init the device
+  volatile uint64_t events;          ///< status changes queued for watch thread
+  volatile uint64_t eventsDropped;   ///< status changes lost, because queue was full
+  volatile uint64_t playerQueries;   ///< calls into player for replay mode and position
+  volatile uint64_t loopAllocations; ///< heap allocations of watch thread, see Allocations()
+  volatile uint64_t loopsAllocating; ///< iterations of watch thread, which allocated
+  volatile int      suspended;       ///< display is suspended or turned off
+  ciMonHistogram tickDuration;       ///< work of one loop of watch thread
+  ciMonHistogram flushDuration;
+  ciMonHistogram writeLatency;       ///< time spent in write()
+
+  ciMonStats();
+  void Reset();
+  cString Report() const;
+  bool WriteMetrics(const char *szFileName) const;
+
+  static void Add(volatile uint64_t& nCounter, uint64_t n = 1) { __sync_fetch_and_add(&nCounter, n); }
+  static bool CountsAllocations();
+  static uint64_t Allocations();
+};
+
+extern ciMonStats theStats;
+
+#endif
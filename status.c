@@ -24,7 +24,20 @@
 ciMonStatusMonitor::ciMonStatusMonitor(ciMonWatch*    pDev)
 : m_pDev(pDev)
 {
+  AudioTrack();
+}
 
+/**
+ * Push current audio track and channel of primary device to the display.
+ * Tracks selected later by VDR itself are found by the watch thread.
+ */
+void ciMonStatusMonitor::AudioTrack()
+{
+  cDevice *pDevice = cDevice::PrimaryDevice();
+  if(pDevice) {
+    m_pDev->AudioTrack(pDevice->GetCurrentAudioTrack(), //Stereo/Dolby
+                       pDevice->GetAudioChannel());     //0-Stereo,1-Left, 2-Right
+  }
 }
 
 #if VDRVERSNUM >= 10726
@@ -42,6 +55,7 @@ void ciMonStatusMonitor::ChannelSwitch(const cDevice *pDevice, int nChannelNumbe
         dsyslog("iMonLCD: channel switched to %d on DVB %d", nChannelNumber, pDevice->CardIndex());
 #endif
         m_pDev->Channel(nChannelNumber);
+        AudioTrack();
     }
 }
 
@@ -53,6 +67,22 @@ void ciMonStatusMonitor::SetVolume(int Volume, bool Absolute)
   m_pDev->Volume(Volume,Absolute);
 }
 
+void ciMonStatusMonitor::SetAudioTrack(int Index, const char * const *Tracks)
+{
+#ifdef MOREDEBUGMSG
+  dsyslog("iMonLCD: SetAudioTrack %d", Index);
+#endif
+  AudioTrack();
+}
+
+void ciMonStatusMonitor::SetAudioChannel(int AudioChannel)
+{
+#ifdef MOREDEBUGMSG
+  dsyslog("iMonLCD: SetAudioChannel %d", AudioChannel);
+#endif
+  AudioTrack();
+}
+
 void ciMonStatusMonitor::Recording(const cDevice *pDevice, const char *szName, const char *szFileName, bool bOn)
 {
 #ifdef MOREDEBUGMSG
@@ -67,6 +97,7 @@ void ciMonStatusMonitor::Replaying(const cControl *pControl, const char *szName,
   dsyslog("iMonLCD: Replaying  %s", szName);
 #endif
   m_pDev->Replaying(pControl,szName,szFileName,bOn);
+  AudioTrack();
 }
 
 void ciMonStatusMonitor::OsdClear(void)
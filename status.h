@@ -32,6 +32,8 @@ class ciMonStatusMonitor : public cStatus {
   virtual void Recording(const cDevice *pDevice, const char *szName, const char *szFileName, bool bOn);
   virtual void Replaying(const cControl *pControl, const char *szName, const char *szFileName, bool bOn);
   virtual void SetVolume(int Volume, bool Absolute);
+  virtual void SetAudioTrack(int Index, const char * const *Tracks);
+  virtual void SetAudioChannel(int AudioChannel);
   virtual void OsdClear(void);
   virtual void OsdTitle(const char *Title);
   virtual void OsdStatusMessage(const char *Message);
@@ -40,6 +42,7 @@ class ciMonStatusMonitor : public cStatus {
   virtual void OsdTextItem(const char *Text, bool Scroll);
   virtual void OsdChannel(const char *Text);
   virtual void OsdProgramme(time_t PresentTime, const char *PresentTitle, const char *PresentSubtitle, time_t FollowingTime, const char *FollowingTitle, const char *FollowingSubtitle);
+  void AudioTrack();
 };
 
 #endif
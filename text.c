@@ -0,0 +1,131 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <ctype.h>
+
+#include "text.h"
+
+/**
+ * Length of truncated text, which ends at a character boundary of UTF-8.
+ * \param sz    Text, which is truncated after n bytes.
+ * \param cNext First byte, which doesn't fit.
+ */
+static int Truncate(const char *sz, int n, char cNext)
+{
+  if((cNext & 0xC0) != 0x80)
+    return n;
+  while(n > 0 && (sz[n - 1] & 0xC0) == 0x80)
+    --n;
+  return n > 0 ? n - 1 : 0;
+}
+
+/**
+ * Copy text, NULL is stored as empty text.
+ * \return true, if the text was changed.
+ */
+bool ciMonText::Set(const char *sz)
+{
+  int nDiff = TEXT_SIZE;  // first changed byte
+  int n = 0;
+  for(; sz && sz[n] && n < TEXT_SIZE - 1; ++n) {
+    if(m_szText[n] != sz[n]) {
+      m_szText[n] = sz[n];
+      if(nDiff > n)
+        nDiff = n;
+    }
+  }
+  if(sz && sz[n])
+    n = Truncate(sz, n, sz[n]);
+  return Terminate(n, nDiff);
+}
+
+/**
+ * Copy text, tabs and runs of white space become a single blank, leading
+ * and trailing white space is removed. Like compactspace() of VDR,
+ * but in one pass and without a temporary copy.
+ * \return true, if the text was changed.
+ */
+bool ciMonText::SetCompact(const char *sz)
+{
+  int nDiff = TEXT_SIZE;  // first changed byte
+  bool bSpace = false;
+  int n = 0;
+  for(const char *s = sz; s && *s; ++s) {
+    if(isspace((unsigned char)*s)) {
+      bSpace = (n > 0);
+      continue;
+    }
+    if(n + (bSpace ? 1 : 0) >= TEXT_SIZE - 1) {
+      if(!bSpace)
+        n = Truncate(m_szText, n, *s);
+      break;
+    }
+    if(bSpace) {
+      if(m_szText[n] != ' ') {
+        m_szText[n] = ' ';
+        if(nDiff > n)
+          nDiff = n;
+      }
+      ++n;
+      bSpace = false;
+    }
+    if(m_szText[n] != *s) {
+      m_szText[n] = *s;
+      if(nDiff > n)
+        nDiff = n;
+    }
+    ++n;
+  }
+  return Terminate(n, nDiff);
+}
+
+/**
+ * End text after n bytes.
+ * \return true, if the text was changed before this position or got another length.
+ */
+bool ciMonText::Terminate(int n, int nDiff)
+{
+  bool bChanged = nDiff < n || n != m_nLength;
+  m_szText[n] = '\0';
+  m_nLength = n;
+  return bChanged;
+}
+
+/**
+ * Start of the first character, which differs from the given text.
+ * \return -1, if both texts are equal.
+ */
+int ciMonText::FirstDiff(const char *sz) const
+{
+  if(!sz)
+    sz = "";
+  int n = 0;
+  while(n < m_nLength && m_szText[n] == sz[n])
+    ++n;
+  if(n == m_nLength && !sz[n])
+    return -1;
+  while(n > 0 && (m_szText[n] & 0xC0) == 0x80)
+    --n;
+  return n;
+}
+
+/**
+ * \return true, if the text wasn't empty.
+ */
+bool ciMonText::Clear()
+{
+  bool bChanged = m_nLength != 0;
+  m_szText[0] = '\0';
+  m_nLength = 0;
+  return bChanged;
+}
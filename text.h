@@ -0,0 +1,41 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_TEXT_H
+#define __IMON_TEXT_H
+
+#define TEXT_SIZE 256  ///< longer texts are truncated
+
+/**
+ * Text with fixed capacity, stored inline without heap allocation.
+ * Setters compare while they copy, and report whether the text was changed.
+ */
+class ciMonText {
+private:
+  char m_szText[TEXT_SIZE];
+  int  m_nLength;
+  bool Terminate(int n, int nDiff);
+public:
+  ciMonText() : m_nLength(0) { m_szText[0] = '\0'; }
+
+  bool Set(const char *sz);
+  bool SetCompact(const char *sz);
+  bool Clear();
+  int FirstDiff(const char *sz) const;
+
+  bool IsEmpty() const { return m_nLength == 0; }
+  int Length() const { return m_nLength; }
+  operator const char*() const { return m_szText; }
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+/*
+ * Counts heap allocations of each thread, to check that the display loop
+ * doesn't allocate in steady state.
+ *
+ * malloc, calloc, realloc, free and the aligned allocators are interposed
+ * and forwarded to glibc, operator new and delete end up there too. The plugin looks for
+ * imonlcd_alloc_count() at runtime; if found, STAT reports allocations of
+ * the watch thread and BENCH fails, if rendering of frames allocates.
+ *
+ * Build with 'make alloc', usage:
+ *   LD_PRELOAD=tools/libimonlcd-alloc.so vdr -P'imonlcd -d /tmp/lcd0'
+ */
+
+#include <stddef.h>
+#include <errno.h>
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *p);
+
+static __thread unsigned long long nMallocs __attribute__((tls_model("initial-exec")));
+static __thread unsigned long long nFrees __attribute__((tls_model("initial-exec")));
+
+void *malloc(size_t size)
+{
+  ++nMallocs;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+  ++nMallocs;
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+  ++nMallocs;
+  if(p)
+    ++nFrees;
+  return __libc_realloc(p, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+  ++nMallocs;
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+  ++nMallocs;
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **pp, size_t alignment, size_t size)
+{
+  // glibc has no internal entry, check arguments like posix_memalign does
+  if(alignment % sizeof(void *) || (alignment & (alignment - 1)) || !alignment)
+    return EINVAL;
+  ++nMallocs;
+  void *p = __libc_memalign(alignment, size);
+  if(!p)
+    return ENOMEM;
+  *pp = p;
+  return 0;
+}
+
+void *valloc(size_t size)
+{
+  ++nMallocs;
+  return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size)
+{
+  ++nMallocs;
+  return __libc_pvalloc(size);
+}
+
+void free(void *p)
+{
+  if(p)
+    ++nFrees;
+  __libc_free(p);
+}
+
+/**
+ * Allocations and releases of the calling thread, since it was started.
+ */
+void imonlcd_alloc_count(unsigned long long *pMallocs, unsigned long long *pFrees)
+{
+  if(pMallocs)
+    *pMallocs = nMallocs;
+  if(pFrees)
+    *pFrees = nFrees;
+}
+
+}
@@ -0,0 +1,298 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+/*
+ * Stand-in for /dev/lcd0, without display and kernel module.
+ *
+ * Creates a FIFO, which is given to the plugin as device (-d), and decodes
+ * all 8 byte packets written into it: display memory registers are
+ * reassembled to frames, icons, progress bars, contrast and other commands
+ * are reported. Each frame can be stored as PBM image.
+ *
+ * Build with 'make mock', usage:
+ *   tools/imonlcd-mock [-v] [-o dir] [-t file] [-w width] [-h height] /tmp/lcd0
+ *   vdr -P'imonlcd -d /tmp/lcd0'
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#define PACKET_SIZE    8
+#define REGISTER_FIRST 0x20
+#define REGISTER_LAST  0x3b
+#define REGISTER_BYTES 7
+#define MEMORY_SIZE    ((REGISTER_LAST - REGISTER_FIRST + 1) * REGISTER_BYTES)
+#define FRAME_IDLE_MS  20    ///< a frame is complete, if no more register is written
+
+static volatile bool bStop = false;
+
+static int nWidth = 96;
+static int nHeight = 16;
+static bool bVerbose = false;
+static const char* szOutput = NULL;
+static FILE* fTimestamps = NULL;
+
+static unsigned char memory[MEMORY_SIZE];
+static int nLastRegister = -1;   ///< last written register of pending frame, -1 if none
+
+static struct {
+  unsigned long packets;
+  unsigned long registers;
+  unsigned long frames;
+  unsigned long icons;
+  unsigned long lines;
+  unsigned long commands;
+  uint64_t      intervalSum;
+  uint64_t      intervalMax;
+  uint64_t      intervalMin;
+} stats;
+
+static uint64_t NowUs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void OnSignal(int)
+{
+  bStop = true;
+}
+
+static void WritePBM(unsigned long nFrame)
+{
+  char szFile[4096];
+  snprintf(szFile, sizeof(szFile), "%s/frame-%06lu.pbm", szOutput, nFrame);
+  FILE* f = fopen(szFile, "w");
+  if(!f) {
+    fprintf(stderr, "unable to write %s (%s)\n", szFile, strerror(errno));
+    return;
+  }
+  fprintf(f, "P1\n%d %d\n", nWidth, nHeight);
+  for(int y = 0; y < nHeight; ++y) {
+    for(int x = 0; x < nWidth; ++x) {
+      int n = x + (y / 8) * nWidth;
+      bool bSet = n < MEMORY_SIZE && (memory[n] & (0x80 >> (y % 8)));
+      fputs(bSet ? "1 " : "0 ", f);
+    }
+    fputc('\n', f);
+  }
+  fclose(f);
+}
+
+static void CompleteFrame()
+{
+  if(nLastRegister < 0)
+    return;
+  ++stats.frames;
+  if(bVerbose)
+    printf("frame %lu\n", stats.frames);
+  if(szOutput)
+    WritePBM(stats.frames);
+  nLastRegister = -1;
+}
+
+static void Decode(const unsigned char* packet, uint64_t nTime)
+{
+  uint64_t cmd = 0;
+  for(int i = PACKET_SIZE - 1; i >= 0; --i)
+    cmd = (cmd << 8) | packet[i];
+  unsigned char type = packet[PACKET_SIZE - 1];
+
+  if(fTimestamps)
+    fprintf(fTimestamps, "%llu %016llx\n", (unsigned long long)nTime, (unsigned long long)cmd);
+
+  if(type >= REGISTER_FIRST && type <= REGISTER_LAST) {
+    // registers are written in ascending order, a lower one starts a new frame
+    if(type <= nLastRegister)
+      CompleteFrame();
+    memcpy(memory + (type - REGISTER_FIRST) * REGISTER_BYTES, packet, REGISTER_BYTES);
+    nLastRegister = type;
+    ++stats.registers;
+    return;
+  }
+
+  CompleteFrame();
+  cmd &= 0x00FFFFFFFFFFFFFFULL;
+  switch(type) {
+    case 0x01:
+      ++stats.icons;
+      if(bVerbose)
+        printf("icons    %014llx\n", (unsigned long long)cmd);
+      break;
+    case 0x10: case 0x11: case 0x12:
+      ++stats.lines;
+      if(bVerbose)
+        printf("lines%d   %014llx\n", type - 0x10, (unsigned long long)cmd);
+      break;
+    case 0x02:
+      ++stats.commands;
+      if(bVerbose)
+        printf("init\n");
+      break;
+    case 0x03:
+      ++stats.commands;
+      if(bVerbose)
+        printf("contrast %llu\n", (unsigned long long)(cmd & 0xFF));
+      break;
+    case 0x50: case 0x88:
+      ++stats.commands;
+      if(bVerbose)
+        printf("display  %s\n", (cmd & 0x40) ? "on" : (cmd & 0x08) ? "shutdown" : "clock");
+      break;
+    case 0x51: case 0x8a:
+      ++stats.commands;
+      if(bVerbose)
+        printf("alarm    %014llx\n", (unsigned long long)cmd);
+      break;
+    default:
+      ++stats.commands;
+      if(bVerbose)
+        printf("unknown  %016llx\n", (unsigned long long)(cmd | ((uint64_t)type << 56)));
+      break;
+  }
+}
+
+static void Report()
+{
+  printf("%lu packets, %lu frames (%.1f registers/frame), %lu icons, %lu progress bars, %lu other commands\n",
+         stats.packets, stats.frames,
+         stats.frames ? (double)stats.registers / stats.frames : 0.0,
+         stats.icons, stats.lines, stats.commands);
+  if(stats.packets > 1) {
+    printf("interval between writes min %llu us, avg %llu us, max %llu us\n",
+           (unsigned long long)stats.intervalMin,
+           (unsigned long long)(stats.intervalSum / (stats.packets - 1)),
+           (unsigned long long)stats.intervalMax);
+  }
+}
+
+static void Usage(const char* szName)
+{
+  fprintf(stderr,
+    "Usage: %s [options] FIFO\n"
+    "  -v          print every decoded command\n"
+    "  -o DIR      store each frame as DIR/frame-NNNNNN.pbm\n"
+    "  -t FILE     log every packet with timestamp (microseconds)\n"
+    "  -w WIDTH    width of display (default 96)\n"
+    "  -h HEIGHT   height of display (default 16)\n"
+    "  -1          exit after the writer has closed the device\n", szName);
+}
+
+int main(int argc, char* argv[])
+{
+  bool bOnce = false;
+  int c;
+  while((c = getopt(argc, argv, "vo:t:w:h:1")) != -1) {
+    switch(c) {
+      case 'v': bVerbose = true; break;
+      case 'o': szOutput = optarg; break;
+      case 't':
+        fTimestamps = fopen(optarg, "w");
+        if(!fTimestamps) {
+          fprintf(stderr, "unable to write %s (%s)\n", optarg, strerror(errno));
+          return 1;
+        }
+        break;
+      case 'w': nWidth = atoi(optarg); break;
+      case 'h': nHeight = atoi(optarg); break;
+      case '1': bOnce = true; break;
+      default: Usage(argv[0]); return 1;
+    }
+  }
+  if(optind >= argc || nWidth <= 0 || nHeight <= 0) {
+    Usage(argv[0]);
+    return 1;
+  }
+  const char* szFifo = argv[optind];
+  if(mkfifo(szFifo, 0666) < 0 && errno != EEXIST) {
+    fprintf(stderr, "unable to create %s (%s)\n", szFifo, strerror(errno));
+    return 1;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = OnSignal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  memset(&stats, 0, sizeof(stats));
+  memset(memory, 0, sizeof(memory));
+  uint64_t nLast = 0;
+
+  while(!bStop) {
+    // wait for the plugin, which opens the device
+    int fd = open(szFifo, O_RDONLY);
+    if(fd < 0) {
+      if(errno == EINTR)
+        continue;
+      fprintf(stderr, "unable to open %s (%s)\n", szFifo, strerror(errno));
+      return 1;
+    }
+
+    unsigned char packet[PACKET_SIZE];
+    size_t nFill = 0;
+    while(!bStop) {
+      struct pollfd p = { fd, POLLIN, 0 };
+      int r = poll(&p, 1, FRAME_IDLE_MS);
+      if(r == 0) {
+        CompleteFrame();
+        continue;
+      }
+      if(r < 0) {
+        if(errno == EINTR)
+          continue;
+        break;
+      }
+      ssize_t n = read(fd, packet + nFill, PACKET_SIZE - nFill);
+      if(n <= 0)
+        break; // writer has closed device
+      nFill += n;
+      if(nFill < PACKET_SIZE)
+        continue;
+      nFill = 0;
+
+      uint64_t nNow = NowUs();
+      if(stats.packets) {
+        uint64_t nInterval = nNow - nLast;
+        stats.intervalSum += nInterval;
+        if(nInterval > stats.intervalMax)
+          stats.intervalMax = nInterval;
+        if(stats.packets == 1 || nInterval < stats.intervalMin)
+          stats.intervalMin = nInterval;
+      }
+      nLast = nNow;
+      ++stats.packets;
+      Decode(packet, nNow);
+    }
+    CompleteFrame();
+    close(fd);
+    if(bOnce)
+      break;
+  }
+
+  if(fTimestamps)
+    fclose(fTimestamps);
+  Report();
+  return 0;
+}
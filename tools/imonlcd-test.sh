@@ -0,0 +1,83 @@
+#!/bin/sh
+#
+# iMON LCD plugin for VDR (C++)
+#
+# (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+#
+# This iMON LCD plugin is free software: you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as published
+# by the Free Software Foundation, version 3 of the License.
+#
+# See the files README and COPYING for details.
+#
+
+#
+# Runs VDR with the plugin against tools/imonlcd-mock, with heap allocations
+# counted by tools/libimonlcd-alloc.so, and plays a scripted session by
+# SVDRP. Fails, if the display loop allocates after warm-up.
+#
+# Called by 'make test', usage:
+#   tools/imonlcd-test.sh libvdr-imonlcd.so APIVERSION [cycles]
+#
+# VDR needs a primary device, without DVB hardware give one by VDRARGS,
+# like VDRARGS=-Pdummydevice. VDR, SVDRPSEND and PORT can be overwritten.
+#
+
+PLUGINLIB=$1
+APIVERSION=$2
+CYCLES=${3:-3}
+VDR=${VDR:-vdr}
+SVDRPSEND=${SVDRPSEND:-svdrpsend}
+PORT=${PORT:-6425}
+
+if [ -z "$PLUGINLIB" ] || [ -z "$APIVERSION" ]; then
+  echo "usage: $0 libvdr-imonlcd.so APIVERSION [cycles]" >&2
+  exit 2
+fi
+
+TOOLS=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d /tmp/imonlcd-test.XXXXXX) || exit 2
+MOCK_PID=
+VDR_PID=
+
+cleanup() {
+  [ -n "$VDR_PID" ] && kill $VDR_PID 2>/dev/null && wait $VDR_PID 2>/dev/null
+  [ -n "$MOCK_PID" ] && kill $MOCK_PID 2>/dev/null && wait $MOCK_PID 2>/dev/null
+  rm -rf "$WORK"
+}
+trap cleanup EXIT INT TERM
+
+mkdir -p "$WORK/lib" "$WORK/config" "$WORK/video" "$WORK/cache"
+ln -s "$(cd "$(dirname "$PLUGINLIB")" && pwd)/$(basename "$PLUGINLIB")" "$WORK/lib/libvdr-imonlcd.so.$APIVERSION"
+echo "127.0.0.1" > "$WORK/config/svdrphosts.conf"
+
+"$TOOLS/imonlcd-mock" "$WORK/lcd0" > "$WORK/mock.log" 2>&1 &
+MOCK_PID=$!
+i=0
+while [ ! -p "$WORK/lcd0" ]; do
+  i=$((i + 1))
+  [ $i -gt 50 ] && { echo "mock device didn't start" >&2; exit 1; }
+  sleep 0.1
+done
+
+LD_PRELOAD="$TOOLS/libimonlcd-alloc.so" "$VDR" --no-kbd -l 3 -p $PORT \
+  -c "$WORK/config" -v "$WORK/video" --cachedir="$WORK/cache" -E- \
+  -L "$WORK/lib" $VDRARGS -P"imonlcd -d $WORK/lcd0" > "$WORK/vdr.log" 2>&1 &
+VDR_PID=$!
+
+# wait for SVDRP and the display
+i=0
+until "$SVDRPSEND" -p $PORT PLUG imonlcd STAT 2>/dev/null | grep -q "^250"; do
+  i=$((i + 1))
+  if [ $i -gt 60 ] || ! kill -0 $VDR_PID 2>/dev/null; then
+    echo "VDR didn't start, see its log:" >&2
+    cat "$WORK/vdr.log" >&2
+    exit 1
+  fi
+  sleep 1
+done
+
+# a cycle of the script takes about 15 s
+REPLY=$("$SVDRPSEND" -p $PORT -t $((CYCLES * 30 + 30)) PLUG imonlcd SESSION $CYCLES)
+echo "$REPLY"
+echo "$REPLY" | grep -q "^250 "
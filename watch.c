@@ -16,10 +16,12 @@
 #include <stdint.h>
 #include <time.h>
 #include <ctype.h>
+#include <sys/time.h>
 
 #include "watch.h"
 #include "setup.h"
 #include "ffont.h"
+#include "stats.h"
 
 #include <vdr/tools.h>
 #include <vdr/shutdown.h>
@@ -40,9 +42,17 @@ ciMonWatch::ciMonWatch()
 : cThread("iMonLCD: watch thread")
 , m_bShutdown(false)
 {
-  m_nIconsForceOn = 0;
-  m_nIconsForceOff = 0;
-  m_nIconsForceMask = 0;
+  m_Shared.nIconsForceOn = 0;
+  m_Shared.bPause = false;
+  m_bPaused = false;
+  m_Shared.nIconsForceOff = 0;
+  m_Shared.nIconsForceMask = 0;
+  m_Shared.bUpdateScreen = false;
+  m_Shared.bFonts = false;
+  m_Shared.bMetrics = false;
+  m_Shared.bTwoLineMode = false;
+  m_Shared.pFontBig = NULL;
+  m_Shared.pFontSmall = NULL;
 
   unsigned int n;
   for(n=0;n<memberof(m_nCardIsRecording);++n) {
@@ -50,23 +60,32 @@ ciMonWatch::ciMonWatch()
   }
   chPresentTime = 0;
   chFollowingTime = 0;
-  chName = NULL;
-  chPresentTitle = NULL;
-  chPresentShortTitle = NULL;
+#if APIVERSNUM < 20302
+  m_tSchedulesModified = 0;
+#endif
+  m_tProgramRetry = 0;
 
   m_nLastVolume = cDevice::CurrentVolume();
   m_bVolumeMute = false;
-
-  osdTitle = NULL;  
-  osdItem = NULL;
-  osdMessage = NULL;
+  m_eAudioTrackType = ttNone;
+  m_nAudioChannel = 0;
+  m_nAudioChecks = AUDIO_CHECKS;
 
   m_pControl = NULL;
-  replayTitle = NULL;
-  replayTitleLast = NULL;
-  replayTime = NULL;
 
-  currentTime = NULL;
+  tsCurrentLast = 0;
+  m_nFrameRate = 0;
+  m_nFrameRateNext = 0;
+  m_eReplayState = eReplayNone;
+  m_nReplayModeNext = 0;
+  m_nReplaySyncNext = 0;
+  m_bReplayIndex = false;
+  m_nReplayIndex = 0;
+  m_nReplayTotal = 0;
+  m_nReplayIndexTime = 0;
+  m_pHeader = NULL;
+  m_nHeaderWidth = 0;
+  m_nHeaderRight = 0;
 
   m_eWatchMode = eLiveTV;
   m_eVideoMode = eVideoNone;
@@ -79,51 +98,12 @@ ciMonWatch::ciMonWatch()
 
 ciMonWatch::~ciMonWatch()
 {
-  if(chName) { 
-      delete chName;
-      chName = NULL;
-  }
-  if(chPresentTitle) { 
-      delete chPresentTitle;
-      chPresentTitle = NULL;
-  }
-  if(chPresentShortTitle) { 
-      delete chPresentShortTitle;
-      chPresentShortTitle = NULL;
-  }
-  if(osdMessage) { 
-      delete osdMessage;
-      osdMessage = NULL;
-  }
-  if(osdTitle) { 
-      delete osdTitle;
-      osdTitle = NULL;
-  }
-  if(osdItem) { 
-      delete osdItem;
-      osdItem = NULL;
-  }
-  if(replayTitle) {
-    delete replayTitle;
-    replayTitle = NULL;
-  }
-  if(replayTitleLast) {
-    delete replayTitleLast;
-    replayTitleLast = NULL;
-  }
-  if(replayTime) {
-    delete replayTime;
-    replayTime = NULL;
-  }
-  if(currentTime) {
-    delete currentTime;
-    currentTime = NULL;
-  }
 }
 
 int ciMonWatch::open(const char* szDevice, eProtocol pro) {
     int iRet = ciMonLCD::open(szDevice,pro);
     if(0==iRet) {
+        theStats.suspended = 0;
         m_bShutdown = false;
         m_bUpdateScreen = true;
         Start();
@@ -135,9 +115,14 @@ void ciMonWatch::shutdown(int nExitMode) {
 
   if(Running()) {
     m_bShutdown = true;
-    usleep(500000);
-    Cancel();
+    Wakeup();
+    Cancel(3);
   }
+  if(m_Shared.bFonts) {
+    UseFonts(m_Shared.pFontBig, m_Shared.pFontSmall, m_Shared.bTwoLineMode);
+    m_Shared.bFonts = false;
+  }
+  theStats.suspended = 1;
 
   if(this->isopen()) {
     const cTimer* t = NULL;
@@ -213,59 +198,204 @@ void ciMonWatch::shutdown(int nExitMode) {
     }
   }
   ciMonLCD::close();
+  // last snapshot, the watch thread doesn't update the metrics any more
+  WriteMetrics();
+}
+
+/**
+ * Write metrics file, if any was given.
+ */
+void ciMonWatch::WriteMetrics()
+{
+  cString sMetricsFile;
+  {
+    cMutexLooker m(mutex);
+    sMetricsFile = m_sMetricsFile;
+  }
+  if(!isempty(sMetricsFile))
+    theStats.WriteMetrics(sMetricsFile);
+}
+
+/**
+ * Acknowledge a request of Benchmark(), called by the watch thread.
+ * \return true, while the watch thread must not write to the display.
+ */
+bool ciMonWatch::Paused()
+{
+  cMutexLooker m(mutex);
+  if(m_bPaused != m_Shared.bPause) {
+    m_bPaused = m_Shared.bPause;
+    m_PauseAck.Broadcast();
+  }
+  return m_bPaused;
+}
+
+/**
+ * Wake up the watch thread, to react on changed states.
+ */
+void ciMonWatch::Wakeup()
+{
+  m_Wakeup.Signal();
+}
+
+/// Milliseconds until the next minute begins, then the clock need updates.
+static int MsToNextMinute()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return 60000 - ((tv.tv_sec % 60) * 1000 + tv.tv_usec / 1000);
+}
+
+/// Milliseconds until the progress bar of current event grows, 0 if unknown.
+int ciMonWatch::NextProgressStep() const
+{
+  time_t tDuration = chFollowingTime - chPresentTime;
+  if(tDuration <= 0)
+    return 0;
+  time_t tNow = time(NULL);
+  int nStep = (tNow - chPresentTime) * 32 / tDuration;
+  if(nStep < 0 || nStep >= 32)
+    return 0;
+  time_t tNext = chPresentTime + ((nStep + 1) * tDuration + 31) / 32;
+  return (tNext > tNow) ? (tNext - tNow) * 1000 : 1000;
+}
+
+/**
+ * Schedule a periodic job again. The phase is kept, unless the deadline
+ * was missed by more than a whole period.
+ */
+void ciMonDeadlines::Next(eWatchJob eJob, int nPeriod, uint64_t nNow)
+{
+  uint64_t nNext = m_nDeadline[eJob] + nPeriod;
+  if(!m_nDeadline[eJob] || nNext <= nNow)
+    nNext = nNow + nPeriod;
+  m_nDeadline[eJob] = nNext;
+}
+
+/// Only the given job is due, all others are later or not scheduled.
+bool ciMonDeadlines::DueOnly(eWatchJob eJob, uint64_t nNow) const
+{
+  if(!Due(eJob, nNow))
+    return false;
+  for(int n = 0; n < eJobCount; ++n) {
+    if(n != eJob && Due((eWatchJob)n, nNow))
+      return false;
+  }
+  return true;
+}
+
+/// Milliseconds until the earliest scheduled job, at most nMax.
+int ciMonDeadlines::Delay(uint64_t nNow, int nMax) const
+{
+  int nDelay = nMax;
+  for(int n = 0; n < eJobCount; ++n) {
+    if(!m_nDeadline[n])
+      continue;
+    if(m_nDeadline[n] <= nNow)
+      return 0;
+    if(m_nDeadline[n] - nNow < (uint64_t)nDelay)
+      nDelay = m_nDeadline[n] - nNow;
+  }
+  return nDelay;
 }
 
 void ciMonWatch::Action(void)
 {
   unsigned int nLastIcons = -1;
   int nContrast = -1;
+  int nSpin = 0;         ///< milliseconds per frame of disc animation, 0 if it stands still
 
   unsigned int n;
-  unsigned int nCnt = 0;
   int nLastTopProgressBar = -1;
   int nTopProgressBar = 0;
   int nLastBottomProgressBar = -1;
   int nBottomProgressBar = 0;
-  eTrackType eAudioTrackType = ttNone;
-  int nAudioChannel = 0;
   int current = 0;
   int total = 0;
 
-  cTimeMs runTime;
   struct tm tm_r;
   bool bLastSuspend = false;
+  bool bEvent = true;
+  bool bMetrics = false;
+  ciMonDeadlines jobs;
 
-  for (;!m_bShutdown;++nCnt) {
-    
-    LOCK_THREAD;
+  while(!m_bShutdown) {
+
+    // a benchmark owns the display, until it's finished
+    if(Paused()) {
+      m_Wakeup.Wait(60000);
+      bEvent = true;
+      continue;
+    }
 
+    uint64_t nTickStart = ciMonWriter::NowUs();
+    uint64_t nAllocStart = ciMonStats::Allocations();
+    uint64_t nNow = cTimeMs::Now();
     unsigned int nIcons = 0;
-    bool bUpdateIcons = false;
     bool bFlush = false;
     bool bReDraw = false;
-    bool bSuspend = false;
+    int nHeaderFrom = -1;
+    bool bSuspend = bLastSuspend;
 
     if(m_bShutdown)
       break;
-    else {
-      cMutexLooker m(mutex);
-      runTime.Set();
-
-      time_t ts = time(NULL);
-      if(theSetup.m_nSuspendMode != eSuspendMode_Never 
-          && theSetup.m_nSuspendTimeOff != theSetup.m_nSuspendTimeOn) {
-        struct tm *now = localtime_r(&ts, &tm_r);
-        int clock = now->tm_hour * 100 + now->tm_min;
-        if(theSetup.m_nSuspendTimeOff > theSetup.m_nSuspendTimeOn) { //like 8-20
-          bSuspend = (clock >= theSetup.m_nSuspendTimeOn) 
-                  && (clock <= theSetup.m_nSuspendTimeOff);
-        } else { //like 0-8 and 20..24
-          bSuspend = (clock >= theSetup.m_nSuspendTimeOn) 
-                  || (clock <= theSetup.m_nSuspendTimeOff);
-        }
-        if(theSetup.m_nSuspendMode == eSuspendMode_Timed 
-              && !ShutdownHandler.IsUserInactive()) {
-          bSuspend = false;
+    else if(!bEvent && jobs.DueOnly(eJobSpin, nNow)) {
+      // next frame of disc animation, nothing else has changed
+      SpinDisc();
+      jobs.Next(eJobSpin, nSpin, nNow);
+    } else {
+      nSpin = 0;
+      // copy state of other threads, anything else runs without the mutex
+      ciMonWatchShared shared;
+      {
+        cMutexLooker m(mutex);
+        shared = m_Shared;
+        m_Shared.bUpdateScreen = false;
+        m_Shared.bFonts = false;
+      }
+      if(shared.bFonts) {
+        UseFonts(shared.pFontBig, shared.pFontSmall, shared.bTwoLineMode);
+        m_bUpdateScreen = true;
+      }
+      if(shared.bUpdateScreen)
+        m_bUpdateScreen = true;
+      bMetrics = shared.bMetrics;
+      bEvent |= ProcessEvents();
+
+      // VDR selects the audio track after PMT, transfer mode or player start,
+      // without any status callback. Look at it, until it's settled.
+      if(!m_nAudioChecks) {
+        jobs.Cancel(eJobAudio);
+      } else if(!jobs.Pending(eJobAudio)) {
+        jobs.At(eJobAudio, nNow + AUDIO_CHECK_INTERVAL);
+      } else if(jobs.Due(eJobAudio, nNow)) {
+        if(CheckAudioTrack())
+          m_nAudioChecks = AUDIO_CHECKS;
+        else
+          --m_nAudioChecks;
+        jobs.At(eJobAudio, nNow + AUDIO_CHECK_INTERVAL);
+      }
+
+      // the suspend window is checked every minute, or if any state was changed.
+      if(bEvent || jobs.Due(eJobSuspend, nNow)) {
+        jobs.At(eJobSuspend, nNow + MsToNextMinute());
+        time_t ts = time(NULL);
+        bSuspend = false;
+        if(theSetup.m_nSuspendMode != eSuspendMode_Never 
+            && theSetup.m_nSuspendTimeOff != theSetup.m_nSuspendTimeOn) {
+          struct tm *now = localtime_r(&ts, &tm_r);
+          int clock = now->tm_hour * 100 + now->tm_min;
+          if(theSetup.m_nSuspendTimeOff > theSetup.m_nSuspendTimeOn) { //like 8-20
+            bSuspend = (clock >= theSetup.m_nSuspendTimeOn) 
+                    && (clock <= theSetup.m_nSuspendTimeOff);
+          } else { //like 0-8 and 20..24
+            bSuspend = (clock >= theSetup.m_nSuspendTimeOn) 
+                    || (clock <= theSetup.m_nSuspendTimeOff);
+          }
+          if(theSetup.m_nSuspendMode == eSuspendMode_Timed 
+                && !ShutdownHandler.IsUserInactive()) {
+            bSuspend = false;
+          }
         }
       }
       if(bSuspend != bLastSuspend) {
@@ -281,19 +411,35 @@ void ciMonWatch::Action(void)
         bFlush = true;
         bReDraw = true;
         bLastSuspend = bSuspend;
+        theStats.suspended = bSuspend ? 1 : 0;
       }
 
-      if(!bSuspend) {
-        // every second the clock need updates.
-        if((0 == (nCnt % 5))) {
-           if (theSetup.m_nRenderMode == eRenderMode_DualLine) {
-            bReDraw |= CurrentTime();
-          }
-          if(m_eWatchMode != eLiveTV) {
-            current = 0;
-            total = 0;
-            bReDraw |= ReplayTime(current,total);
-          }
+      if(bSuspend) {
+        jobs.Cancel(eJobClock);
+        jobs.Cancel(eJobReplay);
+        jobs.Cancel(eJobScroll);
+        jobs.Cancel(eJobSpin);
+        jobs.Cancel(eJobProgress);
+      } else {
+        // the clock need updates, if the minute changed.
+        if (theSetup.m_nRenderMode != eRenderMode_DualLine) {
+          jobs.Cancel(eJobClock);
+        } else if(bReDraw || !jobs.Pending(eJobClock) || jobs.Due(eJobClock, nNow)) {
+          bReDraw |= CurrentTime();
+          jobs.At(eJobClock, nNow + MsToNextMinute());
+        }
+        // twice a second the replay position need updates.
+        if(m_eWatchMode == eLiveTV) {
+          jobs.Cancel(eJobReplay);
+        } else {
+          ReplaySync(nNow, bEvent);
+        }
+        if(m_eWatchMode != eLiveTV 
+            && (!jobs.Pending(eJobReplay) || jobs.Due(eJobReplay, nNow))) {
+          current = 0;
+          total = 0;
+          nHeaderFrom = ReplayTime(current,total);
+          jobs.Next(eJobReplay, 500, nNow);
         }
 
         switch(m_eWatchMode) {
@@ -307,7 +453,26 @@ void ciMonWatch::Action(void)
           case eReplayAudioCD:  nIcons |= eIconDiscSpin | eIconDiscEllispe | eIconTopDVD;   break;
         }
 
-        bFlush = RenderScreen(bReDraw);
+        bool bScrollStep = jobs.Due(eJobScroll, nNow);
+        bFlush = RenderScreen(bReDraw, bScrollStep, nHeaderFrom);
+        if(bFlush)
+          ciMonStats::Add(theStats.framesRendered);
+        else if(FrameLost())
+          bFlush = true; // resend unchanged frame, if a write has failed
+        if(!m_bScrollNeeded) {
+          jobs.Cancel(eJobScroll);
+        } else if(bScrollStep || !jobs.Pending(eJobScroll)) {
+          jobs.Next(eJobScroll, 100, nNow);
+        }
+        if(m_eWatchMode == eLiveTV) {
+          int nStep = NextProgressStep();
+          if(nStep > 0)
+            jobs.At(eJobProgress, nNow + nStep);
+          else
+            jobs.Cancel(eJobProgress);
+        } else {
+          jobs.Cancel(eJobProgress);
+        }
         if(m_eWatchMode == eLiveTV) {
             if((chFollowingTime - chPresentTime) > 0) {
               nBottomProgressBar = (time(NULL) - chPresentTime) * 32 / (chFollowingTime - chPresentTime);
@@ -324,32 +489,35 @@ void ciMonWatch::Action(void)
           } else {
               nBottomProgressBar = 0;
           }
+          // disc spins faster with speed of replay
           switch(ReplayMode()) {
               case eReplayNone:
               case eReplayPaused:
-                bUpdateIcons = false;
                 break;
               default:
               case eReplayPlay:
-                bUpdateIcons = (0 == (nCnt % 4));
+                nSpin = theSetup.m_nDiscSpin;
                 nIcons |= eIconDiscRunSpin;
                 break;
               case eReplayBackward1:
                 nIcons |= eIconDiscSpinBackward;
+                // fall through
               case eReplayForward1:
-                break;
-                bUpdateIcons = (0 == (nCnt % 3));
+                nSpin = theSetup.m_nDiscSpin * 3 / 4;
                 nIcons |= eIconDiscRunSpin;
+                break;
               case eReplayBackward2:
                 nIcons |= eIconDiscSpinBackward;
+                // fall through
               case eReplayForward2:
-                bUpdateIcons = (0 == (nCnt % 2));
+                nSpin = theSetup.m_nDiscSpin / 2;
                 nIcons |= eIconDiscRunSpin;
                 break;
               case eReplayBackward3:
                 nIcons |= eIconDiscSpinBackward;
+                // fall through
               case eReplayForward3:
-                bUpdateIcons = true;
+                nSpin = theSetup.m_nDiscSpin / 4;
                 nIcons |= eIconDiscRunSpin;
                 break;
           }
@@ -392,15 +560,11 @@ void ciMonWatch::Action(void)
         if(m_bVolumeMute) {
           nIcons |= eIconVolume;
         } else {
-            if(eAudioTrackType == ttNone || (0 == nCnt % 10)) {
-              eAudioTrackType = cDevice::PrimaryDevice()->GetCurrentAudioTrack(); //Stereo/Dolby
-              nAudioChannel   = cDevice::PrimaryDevice()->GetAudioChannel();      //0-Stereo,1-Left, 2-Right
-            }
-            switch(eAudioTrackType) {
+            switch(m_eAudioTrackType) {
               default:
                 break;
               case ttAudioFirst ... ttAudioLast: {
-                switch(nAudioChannel) {
+                switch(m_nAudioChannel) {
                   case 1:  nIcons |= eIconSpeakerL;  break;
                   case 2:  nIcons |= eIconSpeakerR;  break;
                   case 0:  
@@ -421,18 +585,30 @@ void ciMonWatch::Action(void)
       }
 
       //Force icon state (defined by svdrp)
-      nIcons &= ~(m_nIconsForceMask);
-      nIcons |=  (m_nIconsForceOn);
-      nIcons &= ~(m_nIconsForceOff);
-      if(m_nIconsForceOn & eIconDiscRunSpin) {
-        bUpdateIcons |= (0 == (nCnt % 4));
+      nIcons &= ~(shared.nIconsForceMask);
+      nIcons |=  (shared.nIconsForceOn);
+      nIcons &= ~(shared.nIconsForceOff);
+      if(shared.nIconsForceOn & eIconDiscRunSpin) {
+        if(!nSpin)
+          nSpin = theSetup.m_nDiscSpin;
         nIcons &= ~(eIconDiscSpinBackward);
       }
+      if((nIcons & (eIconDiscSpin | eIconDiscRunSpin)) != (eIconDiscSpin | eIconDiscRunSpin) || bSuspend)
+        nSpin = 0; // disc isn't shown or stands still
 
-      if(bUpdateIcons || nIcons != nLastIcons) {
+      if(nIcons != nLastIcons) {
         icons(nIcons);
         nLastIcons = nIcons;
       }
+      // disc animation runs on its own deadline
+      if(!nSpin) {
+        jobs.Cancel(eJobSpin);
+      } else if(!jobs.Pending(eJobSpin)) {
+        jobs.Next(eJobSpin, nSpin, nNow);
+      } else if(jobs.Due(eJobSpin, nNow)) {
+        SpinDisc();
+        jobs.Next(eJobSpin, nSpin, nNow);
+      }
       if(nTopProgressBar != nLastTopProgressBar
          || nBottomProgressBar != nLastBottomProgressBar ) {
 
@@ -446,65 +622,100 @@ void ciMonWatch::Action(void)
     if(bFlush) {
       flush();
     }
-    int nDelay = (bSuspend ? 1000 : 100) - runTime.Elapsed();
-    if(nDelay <= 10) {
-      nDelay = 10;
+    ciMonStats::Add(theStats.loopIterations);
+    theStats.tickDuration.Add(ciMonWriter::NowUs() - nTickStart);
+    uint64_t nAllocations = ciMonStats::Allocations() - nAllocStart;
+    if(nAllocations) {
+      ciMonStats::Add(theStats.loopAllocations, nAllocations);
+      ciMonStats::Add(theStats.loopsAllocating);
+    }
+
+    // outside of the counted allocations, file output isn't part of the display loop
+    nNow = cTimeMs::Now();
+    if(!bMetrics) {
+      jobs.Cancel(eJobMetrics);
+    } else if(!jobs.Pending(eJobMetrics) || jobs.Due(eJobMetrics, nNow)) {
+      WriteMetrics();
+      jobs.Next(eJobMetrics, METRICS_INTERVAL, nNow);
+    }
+
+    // sleep until the earliest scheduled job, or any state was changed
+    int nDelay = jobs.Delay(nNow, 60000);
+    bEvent = false;
+    if(!m_bShutdown && nDelay > 0) {
+      bEvent = m_Wakeup.Wait(nDelay);
     }
-    cCondWait::SleepMs(nDelay);
   }
   dsyslog("iMonLCD: watch thread closed (pid=%d)", getpid());
 }
 
-bool ciMonWatch::RenderScreen(bool bReDraw) {
-    cString* scRender;
-    cString* scHeader = NULL;
+/// Text to render, NULL if it's empty.
+static const ciMonText* Text(const ciMonText& text)
+{
+  return text.IsEmpty() ? NULL : &text;
+}
+
+/**
+ * Draw the screen, if the contents was changed.
+ * \param bReDraw     Draw also unchanged contents.
+ * \param bScrollStep Move scrolling text to its next position.
+ * \param nHeaderFrom First changed byte of replay time, -1 if unchanged.
+ */
+bool ciMonWatch::RenderScreen(bool bReDraw, bool bScrollStep, int nHeaderFrom) {
+    const ciMonText* scRender = NULL;
+    const ciMonText* scHeader = NULL;
     bool bForce = m_bUpdateScreen;
     bool bAllowCurrentTime = false;
 
-    if(osdMessage) {
-      scRender = osdMessage;
-    } else if(osdItem) {
-      scHeader = osdTitle;
-      scRender = osdItem;
+    if(!osdMessage.IsEmpty()) {
+      scRender = &osdMessage;
+    } else if(!osdItem.IsEmpty()) {
+      scHeader = Text(osdTitle);
+      scRender = &osdItem;
     } else if(m_eWatchMode == eLiveTV) {
-        scHeader = chName;
+        scHeader = Text(chName);
         if(Program()) {
           bForce = true;
         }
-        if(chPresentTitle && theSetup.m_nRenderMode != eRenderMode_SingleTopic) {
-          scRender = chPresentTitle;
+        if(!chPresentTitle.IsEmpty() && theSetup.m_nRenderMode != eRenderMode_SingleTopic) {
+          scRender = &chPresentTitle;
           bAllowCurrentTime = true;
         } else {
-          scHeader = currentTime;
-          scRender = chName;
+          scHeader = Text(currentTime);
+          scRender = Text(chName);
         }
     } else {
         if(Replay()) {
           bForce = true;
         }
-        scHeader = replayTime;
-        scRender = replayTitle;
+        scHeader = Text(replayTime);
+        scRender = Text(replayTitle);
         bAllowCurrentTime = true;
     }
 
 
+    if(nHeaderFrom >= 0 
+        && (scHeader != &replayTime || m_pHeader != &replayTime
+            || pFont->Width(replayTime) != m_nHeaderWidth)) {
+      bReDraw = true;
+    }
     if(bForce) {
       m_nScrollOffset = 0;
       m_bScrollBackward = false;
       m_bScrollNeeded = true;
     }
-    if(bForce || bReDraw || m_nScrollOffset > 0 || m_bScrollBackward) {
+    if(bForce || bReDraw || (bScrollStep && (m_nScrollOffset > 0 || m_bScrollBackward))) {
       this->clear();
       if(scRender) {
     
         int iRet = -1;
         if(theSetup.m_nRenderMode == eRenderMode_DualLine) {
-          iRet = this->DrawText(0 - m_nScrollOffset,pFont->Height(), *scRender);
+          iRet = this->DrawScrollText(pFont->Height(), *scRender, m_nScrollOffset);
         } else {
           int nTop = (theSetup.m_nHeight - pFont->Height())/2;
-          iRet = this->DrawText(0 - m_nScrollOffset,nTop<0?0:nTop, *scRender);
+          iRet = this->DrawScrollText(nTop<0?0:nTop, *scRender, m_nScrollOffset);
         }
-        if(m_bScrollNeeded) {
+        if(m_bScrollNeeded && (bForce || bScrollStep)) {
           switch(iRet) {
             case 0: 
               if(m_nScrollOffset <= 0) {
@@ -514,6 +725,7 @@ bool ciMonWatch::RenderScreen(bool bReDraw) {
                 break; //Fit to screen
               }
               m_bScrollBackward = true;
+              // fall through
             case 2:
             case 1:
               if(m_bScrollBackward) m_nScrollOffset -= 2;
@@ -521,6 +733,7 @@ bool ciMonWatch::RenderScreen(bool bReDraw) {
               if(m_nScrollOffset >= 0) {
                 break;
               }
+              // fall through
             case -1:
               m_nScrollOffset = 0;
               m_bScrollBackward = false;
@@ -530,12 +743,17 @@ bool ciMonWatch::RenderScreen(bool bReDraw) {
         }
       }
 
+      m_pHeader = NULL;
       if(scHeader && theSetup.m_nRenderMode == eRenderMode_DualLine) {
-        if(bAllowCurrentTime && currentTime) {
-          int t = pFont->Width(*currentTime);
-          int w = pFont->Width(*scHeader);
+        int w = pFont->Width(*scHeader);
+        m_pHeader = scHeader;
+        m_nHeaderWidth = w;
+        m_nHeaderRight = theSetup.m_nWidth;
+        if(bAllowCurrentTime && !currentTime.IsEmpty()) {
+          int t = pFont->Width(currentTime);
           if((w + t + 3) < theSetup.m_nWidth && t < theSetup.m_nWidth) {
-            this->DrawText(theSetup.m_nWidth - t, 0, *currentTime);
+            this->DrawText(theSetup.m_nWidth - t, 0, currentTime);
+            m_nHeaderRight = theSetup.m_nWidth - t;
           } 
         }
         this->DrawText(0, 0, *scHeader);
@@ -544,6 +762,14 @@ bool ciMonWatch::RenderScreen(bool bReDraw) {
       m_bUpdateScreen = false;
       return true;
     }
+    if(nHeaderFrom >= 0) {
+      // only digits of replay time have changed, with same width of text
+      // they are drawn again at their place, the rest of screen is kept
+      int x = pFont->PrefixWidth(replayTime, nHeaderFrom);
+      this->clear(x, 0, m_nHeaderRight - x, pFont->Height());
+      this->DrawText(x, 0, (const char *)replayTime + nHeaderFrom);
+      return true;
+    }
     return false;
 }
 
@@ -551,182 +777,79 @@ bool ciMonWatch::CurrentTime() {
   time_t ts = time(NULL);
 
   if((ts / 60) != (tsCurrentLast / 60)) {
-
-    if(currentTime)
-      delete currentTime;
-
+    struct tm tm_r;
+    char sz[8];
     tsCurrentLast = ts;
-    currentTime = new cString(TimeString(ts));
-    return currentTime != NULL;
+    if(localtime_r(&ts, &tm_r))
+      snprintf(sz, sizeof(sz), "%02d:%02d", tm_r.tm_hour, tm_r.tm_min);
+    else
+      strcpy(sz, "??:??");
+    return currentTime.Set(sz);
   } 
   return false;
 }
 
 bool ciMonWatch::Replay() {
   
-  if(!replayTitleLast 
-      || !replayTitle 
-      || strcmp(*replayTitleLast,*replayTitle)) {
-    if(replayTitleLast) {
-      delete replayTitleLast;
-      replayTitleLast = NULL;
-    }
-    if(replayTitle) {
-      replayTitleLast = new cString(*replayTitle);
-    }
-    return true;
-  }
-  return false;
-}
-
-char *striptitle(char *s)
-{
-  if (s && *s) {
-     for (char *p = s + strlen(s) - 1; p >= s; p--) {
-         if (isspace(*p) || *p == '~' || *p == '\\')
-           *p = 0;
-         else
-            break;
-         }
-     }
-  return s;
+  return replayTitleLast.Set(replayTitle);
 }
 
+/**
+ * Replay was started or stopped. The control is taken at once, so it isn't
+ * used after it was stopped, the name is evaluated by the watch thread.
+ */
 void ciMonWatch::Replaying(const cControl * Control, const char * szName, const char *FileName, bool On)
 {
-    cMutexLooker m(mutex);
-    m_bUpdateScreen = true;
-    if (On)
     {
-        m_eVideoMode  = eVideoMPG;
-        m_eAudioMode  = eAudioMPG;
-
+      cMutexLock lock(&m_ControlMutex);
 #if APIVERSNUM >= 20302
-        m_pControl = Control;
+      m_pControl = On ? Control : NULL;
 #else
-        m_pControl = (cControl *)Control;
+      m_pControl = On ? (cControl *)Control : NULL;
 #endif
-        m_eWatchMode = eReplayNormal;
-        if(replayTitle) {
-          delete replayTitle;
-          replayTitle = NULL;
-        }
-        m_eReplayMode = eReplayModeNormal;
-        if (szName && !isempty(szName))
-        {
-            char* Title = NULL;
-            char* Name = strdup(skipspace(szName));
-            striptitle(Name); // remove space at end
-            int slen = strlen(Name);
-            ///////////////////////////////////////////////////////////////////////
-            //Looking for mp3/muggle-plugin replay : [LS] (444/666) title
-            //
-            if (slen > 6 &&
-                *(Name+0)=='[' &&
-                *(Name+3)==']' &&
-                *(Name+5)=='(') {
-                int i;
-                for (i=6; *(Name + i) != '\0'; ++i) { //search for [xx] (xxxx) title
-                    if (*(Name+i)==' ' && *(Name+i-1)==')') { //found mp3/muggle-plugin
-                        // get loopmode
-                        if ((*(Name+1) != '.') && (*(Name+2) != '.')) {
-                                                m_eReplayMode = eReplayModeRepeatShuffle;
-                        } else {
-                          if (*(Name+1) != '.') m_eReplayMode = eReplayModeRepeat;
-                          if (*(Name+2) != '.') m_eReplayMode = eReplayModeShuffle;
-                        }
-                        if (slen > i) { //if name isn't empty, then copy
-                            Title = (Name + i);
-                        }
-                        m_eWatchMode = eReplayMusic;
-                        m_eVideoMode = eVideoNone;
-                        m_eAudioMode = eAudioMP3;
-                        break;
-                    }
-                }
-            }
-            ///////////////////////////////////////////////////////////////////////
-            //Looking for DVD-Plugin replay : 1/8 4/28,  de 2/5 ac3, no 0/7,  16:9, VOLUMENAME
-            // cDvdPlayerControl::GetDisplayHeaderLine : titleinfo, audiolang, spulang, aspect, title
-            if (!Title && slen>7)
-            {
-                int i,n;
-                for (n=0,i=0;*(Name+i) != '\0';++i)
-                { //search volumelabel after 4*", " => xxx, xxx, xxx, xxx, title
-                    if (*(Name+i)==' ' && *(Name+i-1)==',') {
-                        if (++n == 4) {
-                            if (slen > i) {
-                                // if name isn't empty, then copy
-                                Title = (Name + i);
-                                m_eWatchMode = eReplayDVD;
-                                m_eVideoMode = eVideoMPG;
-                                m_eAudioMode = eAudioMPG;
-                            }
-                            break;
-                        }
-                    }
-                }
-            }
-            if (!Title) {
-                // look for file extentsion like .xxx or .xxxx
-                bool bIsFile = (slen>5 && ((*(Name+slen-4) == '.') || (*(Name+slen-5) == '.'))) ? true : false;
-
-                for (int i=slen-1;i>0;--i)
-                {   //search reverse last Subtitle
-                    // - filename contains '~' => subdirectory
-                    // or filename contains '/' => subdirectory
-                    switch (*(Name+i)) {
-                        case '/':
-                            if (!bIsFile) {
-                                break;
-                            }
-                            m_eWatchMode = eReplayFile;
-                        case '~': {
-                            Title = (Name + i + 1);
-                            i = 0;
-                        }
-                        default:
-                            break;
-                    }
-                }
-            }
+    }
+    if(m_Events.Put(eEventReplaying, On ? 1 : 0, 0, szName, Control))
+      Wakeup();
+}
 
-            if (0 == strncmp(Name,"[image] ",8)) {
-                if (m_eWatchMode != eReplayFile) //if'nt already Name stripped-down as filename
-                    Title = (Name + 8);
-                m_eWatchMode = eReplayImage;
-                m_eVideoMode = eVideoMPG;
-                m_eAudioMode = eAudioNone;
-            }
-            else if (0 == strncmp(Name,"[audiocd] ",10)) {
-                Title = (Name + 10);
-                m_eWatchMode = eReplayAudioCD;
-                m_eVideoMode = eVideoNone;
-                m_eAudioMode = eAudioWAV;
-            }
-            if (Title) {
-                replayTitle = new cString(skipspace(Title));
-            } else {
-                replayTitle = new cString(skipspace(Name));
-            }
-            free(Name);
-        }
-        if (!replayTitle) {
-            replayTitle = new cString(tr("Unknown title"));
+/**
+ * Evaluate name of replay, recognizers are listed in replay.c.
+ * \param pControl Identity of the control, which was started.
+ */
+void ciMonWatch::ReplayingEvent(const void *pControl, const char * szName, bool On)
+{
+    m_bUpdateScreen = true;
+    m_nAudioChecks = AUDIO_CHECKS;
+    m_nFrameRate = 0;
+    m_eReplayState = eReplayNone;
+    m_bReplayIndex = false;
+    if (On)
+    {
+        const ciMonReplayInfo& info = m_Classifier.Classify(pControl, szName);
+        m_eWatchMode = info.watchMode;
+        m_eVideoMode = info.videoMode;
+        m_eAudioMode = info.audioMode;
+        m_eReplayMode = info.replayMode;
+        replayTitle.Set(m_Classifier.Title());
+        if (replayTitle.IsEmpty()) {
+            replayTitle.Set(tr("Unknown title"));
         }
     }
     else
     {
       m_eWatchMode = eLiveTV;
-      m_pControl = NULL;
     }
 }
 
 
-eReplayState ciMonWatch::ReplayMode() const
+/**
+ * Ask the player for its mode, caller must hold m_ControlMutex.
+ */
+eReplayState ciMonWatch::QueryReplayMode() const
 {
   bool Play = false, Forward = false;
   int Speed = -1;
+  ciMonStats::Add(theStats.playerQueries);
   if (m_pControl 
       && m_pControl->GetReplayMode(Play,Forward,Speed)) {
     // 'Play' tells whether we are playing or pausing, 'Forward' tells whether
@@ -749,70 +872,123 @@ eReplayState ciMonWatch::ReplayMode() const
   return eReplayNone;
 }
 
-bool ciMonWatch::ReplayPosition(int &current, int &total, double& dFrameRate) const
+/**
+ * Synchronize with the player. The mode is checked every second and after
+ * any status change, the position only if the mode was changed or every
+ * ten seconds. Between them the position is predicted, see ReplayPosition().
+ * Fast and slow modes don't have a known speed, there the position is
+ * taken at each query.
+ * \param bForce Check mode at once, like after key presses.
+ */
+void ciMonWatch::ReplaySync(uint64_t nNow, bool bForce)
 {
-  if (m_pControl 
-      && m_pControl->GetIndex(current, total, false)) {
+  if(!bForce && nNow < m_nReplayModeNext)
+    return;
 
-    dFrameRate = m_pControl->FramesPerSecond();
-    total = (total == 0) ? 1 : total;
+  cMutexLock lock(&m_ControlMutex);
+  eReplayState eState = QueryReplayMode();
+  bool bPredictable = (eState == eReplayPlay || eState == eReplayPaused);
+  m_nReplayModeNext = nNow + (bPredictable ? 1000 : 500);
+  if(eState == m_eReplayState && m_bReplayIndex && bPredictable && nNow < m_nReplaySyncNext)
+    return;
+  m_eReplayState = eState;
 
-    return true;
+  int current = 0;
+  int total = 0;
+  ciMonStats::Add(theStats.playerQueries);
+  m_bReplayIndex = m_pControl && m_pControl->GetIndex(current, total, false);
+  if(m_bReplayIndex) {
+    // frame rate is known after replay has started, look again from time to time
+    if(!m_nFrameRate || nNow >= m_nFrameRateNext) {
+      ciMonStats::Add(theStats.playerQueries);
+      double dFrameRate = m_pControl->FramesPerSecond();
+      if(dFrameRate <= 0)
+        dFrameRate = DEFAULTFRAMESPERSECOND;
+      m_nFrameRate = (int)(dFrameRate * 1000 + 0.5);
+      m_nFrameRateNext = nNow + 10000;
+    }
+    m_nReplayIndex = current;
+    m_nReplayTotal = (total == 0) ? 1 : total;
+    m_nReplayIndexTime = nNow;
   }
-  return false;
+  m_nReplaySyncNext = nNow + 10000;
+}
+
+/**
+ * Predicted replay position, from last known position, elapsed time and mode.
+ */
+bool ciMonWatch::ReplayPosition(int &current, int &total) const
+{
+  if(!m_bReplayIndex)
+    return false;
+  current = m_nReplayIndex;
+  total = m_nReplayTotal;
+  if(m_eReplayState == eReplayPlay && m_nFrameRate) {
+    uint64_t nElapsed = cTimeMs::Now() - m_nReplayIndexTime;
+    current += (int)(nElapsed * m_nFrameRate / 1000000);
+    if(current > total)
+      current = total;
+  }
+  return true;
 }
 
-const char * ciMonWatch::FormatReplayTime(int current, int total, double dFrameRate) const
+/**
+ * Format replay position like 12:34 (56:07) or 1:23:45 (2:01:00),
+ * with integer math and without temporary strings.
+ */
+void ciMonWatch::FormatReplayTime(char *sz, size_t nSize, int current, int total) const
 {
-    static char s[32];
+    int nRate = m_nFrameRate ? m_nFrameRate : (int)(DEFAULTFRAMESPERSECOND * 1000);
 
-    int cs = (int)((double)current / dFrameRate);
-    int ts = (int)((double)total / dFrameRate);
+    int cs = (int)((int64_t)current * 1000 / nRate);
+    int ts = (int)((int64_t)total * 1000 / nRate);
     bool g = (cs > 3600) || (ts > 3600);
 
-    int cm = cs / 60;
-    cs %= 60;
-    int tm = ts / 60;
-    ts %= 60;
-
-    if (total > 1) {
-      if(g) {
-        snprintf(s, sizeof(s), "%s (%s)", (const char*)IndexToHMSF(current,false,dFrameRate), (const char*)IndexToHMSF(total,false,dFrameRate));
+    if(g) {
+      // rounded like IndexToHMSF()
+      cs = (int)(((int64_t)current * 1000 + 500) / nRate);
+      ts = (int)(((int64_t)total * 1000 + 500) / nRate);
+      if (total > 1) {
+        snprintf(sz, nSize, "%d:%02d:%02d (%d:%02d:%02d)", 
+                 cs / 3600, cs / 60 % 60, cs % 60, ts / 3600, ts / 60 % 60, ts % 60);
       } else {
-        snprintf(s, sizeof(s), "%02d:%02d (%02d:%02d)", cm, cs, tm, ts);
-      } 
+        snprintf(sz, nSize, "%d:%02d:%02d", cs / 3600, cs / 60 % 60, cs % 60);
+      }
     }
     else {
-      if(g) {
-        snprintf(s, sizeof(s), "%s", (const char*)IndexToHMSF(current,false,dFrameRate));
+      if (total > 1) {
+        snprintf(sz, nSize, "%02d:%02d (%02d:%02d)", cs / 60, cs % 60, ts / 60, ts % 60);
       } else {
-        snprintf(s, sizeof(s), "%02d:%02d", cm, cs);
+        snprintf(sz, nSize, "%02d:%02d", cs / 60, cs % 60);
       }
     }
-    return s;
 }
 
-bool ciMonWatch::ReplayTime(int &current, int &total) {
-    double dFrameRate = DEFAULTFRAMESPERSECOND;
-
-    if(ReplayPosition(current,total,dFrameRate) 
+/**
+ * Update replay position.
+ * \return First changed byte of formatted position, -1 if unchanged.
+ */
+int ciMonWatch::ReplayTime(int &current, int &total) {
+    if(ReplayPosition(current,total) 
       && theSetup.m_nRenderMode == eRenderMode_DualLine) {
-      const char * sz = FormatReplayTime(current,total,dFrameRate);
-      if(!replayTime || strcmp(sz,*replayTime)) {
-        if(replayTime)
-          delete replayTime;
-        replayTime = new cString(sz);
-        return replayTime != NULL;      
-      }
+      char sz[32];
+      FormatReplayTime(sz, sizeof(sz), current, total);
+      int nFrom = replayTime.FirstDiff(sz);
+      if(nFrom >= 0)
+        replayTime.Set(sz);
+      return nFrom;
     }
-    return false;
+    return -1;
 }
 
 void ciMonWatch::Recording(const cDevice *pDevice, const char *szName, const char *szFileName, bool bOn)
 {
-  cMutexLooker m(mutex);
+  if(m_Events.Put(eEventRecording, pDevice->CardIndex(), bOn ? 1 : 0))
+    Wakeup();
+}
 
-  unsigned int nCardIndex = pDevice->CardIndex();
+void ciMonWatch::RecordingEvent(unsigned int nCardIndex, bool bOn)
+{
   if (nCardIndex > memberof(m_nCardIsRecording) - 1 )
     nCardIndex = memberof(m_nCardIsRecording)-1;
 
@@ -832,19 +1008,16 @@ void ciMonWatch::Recording(const cDevice *pDevice, const char *szName, const cha
 
 void ciMonWatch::Channel(int ChannelNumber)
 {
-    cMutexLooker m(mutex);
-    if(chPresentTitle) { 
-        delete chPresentTitle;
-        chPresentTitle = NULL;
-    }
-    if(chPresentShortTitle) { 
-        delete chPresentShortTitle;
-        chPresentShortTitle = NULL;
-    }
-    if(chName) { 
-        delete chName;
-        chName = NULL;
-    }
+    if(m_Events.Put(eEventChannel, ChannelNumber))
+      Wakeup();
+}
+
+void ciMonWatch::ChannelEvent(int ChannelNumber)
+{
+    m_nAudioChecks = AUDIO_CHECKS;
+    chPresentTitle.Clear();
+    chPresentShortTitle.Clear();
+    chName.Clear();
 
     m_eVideoMode = eVideoNone;
     m_eAudioMode = eAudioNone;
@@ -864,8 +1037,14 @@ void ciMonWatch::Channel(int ChannelNumber)
       chID = ch->GetChannelID();
       chPresentTime = 0;
       chFollowingTime = 0;
+      // force a lookup of schedule for the new channel
+#if APIVERSNUM >= 20302
+      m_SchedulesKey.Reset();
+#else
+      m_tSchedulesModified = 0;
+#endif
       if (!isempty(ch->Name())) {
-          chName = new cString(ch->Name());
+          chName.Set(ch->Name());
       }
       if(ch->Vpid())  m_eVideoMode  = eVideoMPG;
       if(ch->Apid(0)) m_eAudioMode |= eAudioMPG;
@@ -880,12 +1059,30 @@ void ciMonWatch::Channel(int ChannelNumber)
 bool ciMonWatch::Program() {
     bool bChanged = false;
     const cEvent * p = NULL;
+
+    // if the present event is over, look for the following one,
+    // but not more often than every ten seconds
+    time_t tNow = time(NULL);
+    if(chFollowingTime && tNow >= chFollowingTime && tNow >= m_tProgramRetry) {
 #if APIVERSNUM >= 20302
-    cStateKey lock;
+      m_SchedulesKey.Reset();
+#else
+      m_tSchedulesModified = 0;
+#endif
+      m_tProgramRetry = tNow + 10;
+    }
+
+    // schedules are only locked, if they were changed since last lookup
+#if APIVERSNUM >= 20302
+    cStateKey& lock = m_SchedulesKey;
     const cSchedules * schedules = cSchedules::GetSchedulesRead(lock);
 #else
+    if(m_tSchedulesModified && m_tSchedulesModified == cSchedules::Modified())
+      return false;
     cSchedulesLock lock;
     const cSchedules * schedules = cSchedules::Schedules(lock);
+    if (schedules)
+      m_tSchedulesModified = cSchedules::Modified();
 #endif
     if (schedules) {
       if (chID.Valid()) {
@@ -897,21 +1094,8 @@ bool ciMonWatch::Program() {
             chPresentTime = p->StartTime();
             chFollowingTime = p->EndTime();
 
-            if(chPresentTitle) {
-              delete chPresentTitle;
-              chPresentTitle = NULL;
-            }
-            if (!isempty(p->Title())) {
-              chPresentTitle = new cString(p->Title());
-            }
-
-            if(chPresentShortTitle) {
-              delete chPresentShortTitle;
-              chPresentShortTitle = NULL;
-            }
-            if (!isempty(p->ShortText())) {
-              chPresentShortTitle = new cString(p->ShortText());
-            }
+            chPresentTitle.Set(isempty(p->Title()) ? NULL : p->Title());
+            chPresentShortTitle.Set(isempty(p->ShortText()) ? NULL : p->ShortText());
           }
         }
       }
@@ -924,8 +1108,12 @@ bool ciMonWatch::Program() {
 
 void ciMonWatch::Volume(int nVolume, bool bAbsolute)
 {
-  cMutexLooker m(mutex);
+  if(m_Events.Put(eEventVolume, nVolume, bAbsolute ? 1 : 0))
+    Wakeup();
+}
 
+void ciMonWatch::VolumeEvent(int nVolume, bool bAbsolute)
+{
   int nAbsVolume;
 
   nAbsVolume = m_nLastVolume;
@@ -951,127 +1139,210 @@ void ciMonWatch::Volume(int nVolume, bool bAbsolute)
 }
 
 
+/**
+ * Audio track or audio channel of primary device was changed.
+ */
+void ciMonWatch::AudioTrack(eTrackType eType, int nChannel)
+{
+  if(m_Events.Put(eEventAudioTrack, eType, nChannel))
+    Wakeup();
+}
+
+void ciMonWatch::AudioTrackEvent(eTrackType eType, int nChannel)
+{
+  m_eAudioTrackType = eType;
+  m_nAudioChannel = nChannel;
+}
+
+/**
+ * Look at audio track of primary device, called by watch thread.
+ * \return true, if audio track or audio channel was changed.
+ */
+bool ciMonWatch::CheckAudioTrack()
+{
+  cDevice *pDevice = cDevice::PrimaryDevice();
+  if(!pDevice)
+    return false;
+  eTrackType eType = pDevice->GetCurrentAudioTrack();
+  int nChannel = pDevice->GetAudioChannel();
+  if(eType == m_eAudioTrackType && nChannel == m_nAudioChannel)
+    return false;
+  AudioTrackEvent(eType, nChannel);
+  return true;
+}
+
 void ciMonWatch::OsdClear() {
-    cMutexLooker m(mutex);
-    if(osdMessage) { 
-        delete osdMessage;
-        osdMessage = NULL;
+    if(m_Events.Put(eEventOsdClear))
+      Wakeup();
+}
+
+void ciMonWatch::OsdTitle(const char *sz) {
+    if(m_Events.Put(eEventOsdTitle, 0, 0, sz))
+      Wakeup();
+}
+
+void ciMonWatch::OsdCurrentItem(const char *sz)
+{
+    if(m_Events.Put(eEventOsdItem, 0, 0, sz))
+      Wakeup();
+}
+
+void ciMonWatch::OsdStatusMessage(const char *sz)
+{
+    if(m_Events.Put(eEventOsdMessage, 0, 0, sz))
+      Wakeup();
+}
+
+void ciMonWatch::OsdClearEvent() {
+    if(osdMessage.Clear())
         m_bUpdateScreen = true;
-    }
-    if(osdTitle) { 
-        delete osdTitle;
-        osdTitle = NULL;
+    if(osdTitle.Clear())
         m_bUpdateScreen = true;
-    }
-    if(osdItem) { 
-        delete osdItem;
-        osdItem = NULL;
+    if(osdItem.Clear())
         m_bUpdateScreen = true;
-    }
 }
 
-void ciMonWatch::OsdTitle(const char *sz) {
-    char *s = NULL;
-    char *sc = NULL;
-    if(sz && !isempty(sz)) {
-        s = strdup(sz);
-        sc = compactspace(strreplace(s,'\t',' '));
-    }
-    if(sc 
-        && osdTitle 
-        && 0 == strcmp(sc, *osdTitle)) {
-      if(s) {
-        free(s);
-      }
-      return;
-    }
-    cMutexLooker m(mutex);
-    if(osdTitle) { 
-        delete osdTitle;
-        osdTitle = NULL;
+/**
+ * Replace text of OSD title, item or message, if it was changed.
+ * Tabs and runs of blanks are compacted without copy of the text.
+ */
+void ciMonWatch::OsdTextEvent(ciMonText& text, const char *sz)
+{
+    if(text.SetCompact(sz))
         m_bUpdateScreen = true;
-    }
-    if(sc) {
-          osdTitle = new cString(sc);
-          m_bUpdateScreen = true;
-    }
-    if(s) {
-      free(s);
-    }
 }
 
-void ciMonWatch::OsdCurrentItem(const char *sz)
+/**
+ * Apply all queued status changes, called by watch thread without the mutex.
+ * It touches only state of the watch thread, producers never wait for it.
+ * \return true, if any event was processed.
+ */
+bool ciMonWatch::ProcessEvents()
 {
-    char *s = NULL;
-    char *sc = NULL;
-    if(sz && !isempty(sz)) {
-        s = strdup(sz);
-        sc = compactspace(strreplace(s,'\t',' '));
-    }
-    if(sc 
-        && osdItem 
-        && 0 == strcmp(sc, *osdItem)) {
-      if(s) {
-        free(s);
+    ciMonEvent e;
+    bool bAny = false;
+    while(m_Events.Get(e)) {
+      bAny = true;
+      switch(e.type) {
+        case eEventReplaying:  ReplayingEvent(e.source, e.text, e.value != 0); break;
+        case eEventRecording:  RecordingEvent(e.value, e.option != 0); break;
+        case eEventChannel:    ChannelEvent(e.value); break;
+        case eEventVolume:     VolumeEvent(e.value, e.option != 0); break;
+        case eEventAudioTrack: AudioTrackEvent((eTrackType)e.value, e.option); break;
+        case eEventOsdClear:   OsdClearEvent(); break;
+        case eEventOsdTitle:   OsdTextEvent(osdTitle, e.text); break;
+        case eEventOsdItem:    OsdTextEvent(osdItem, e.text); break;
+        case eEventOsdMessage: OsdTextEvent(osdMessage, e.text); break;
       }
-      return;
     }
-    cMutexLooker m(mutex);
-    if(osdItem) { 
-        delete osdItem;
-        osdItem = NULL;
-        m_bUpdateScreen = true;
-    }
-    if(sc) {
-          osdItem = new cString(sc);
-          m_bUpdateScreen = true;
-    }
-    if(s) {
-      free(s);
+    if(m_Events.Resync()) {
+      ResyncEvent();
+      bAny = true;
     }
+    return bAny;
 }
 
-void ciMonWatch::OsdStatusMessage(const char *sz)
+/**
+ * Events were dropped, because the queue was full. Read the state again,
+ * as far as VDR can tell it, texts of OSD are shown with their next change.
+ */
+void ciMonWatch::ResyncEvent()
 {
-    char *s = NULL;
-    char *sc = NULL;
-    if(sz && !isempty(sz)) {
-        s = strdup(sz);
-        sc = compactspace(strreplace(s,'\t',' '));
-    }
-    if(sc 
-        && osdMessage 
-        && 0 == strcmp(sc, *osdMessage)) {
-      if(s) {
-        free(s);
-      }
-      return;
-    }
-    cMutexLooker m(mutex);
-    if(osdMessage) { 
-        delete osdMessage;
-        osdMessage = NULL;
-        m_bUpdateScreen = true;
-    }
-    if(sc) {
-          osdMessage = new cString(sc);
-          m_bUpdateScreen = true;
-    }
-    if(s) {
-      free(s);
+    dsyslog("iMonLCD: events were dropped, read state again");
+    const void *pControl;
+    {
+      cMutexLock lock(&m_ControlMutex);
+      pControl = m_pControl;
     }
+    if(!pControl && m_eWatchMode != eLiveTV)
+      ReplayingEvent(NULL, "", false);
+    else if(pControl && m_eWatchMode == eLiveTV)
+      ReplayingEvent(pControl, "", true); // name of replay is lost
+    if(m_eWatchMode == eLiveTV)
+      ChannelEvent(cDevice::CurrentChannel());
+    VolumeEvent(cDevice::CurrentVolume(), true);
+    CheckAudioTrack();
+    m_nAudioChecks = AUDIO_CHECKS;
+    m_bUpdateScreen = true;
 }
 
 bool ciMonWatch::SetFont(const char *szFont, bool bTwoLineMode, int nBigFontHeight, int nSmallFontHeight) {
-    cMutexLooker m(mutex);
-    if(ciMonLCD::SetFont(szFont, bTwoLineMode, nBigFontHeight, nSmallFontHeight)) {
+    // load fonts without blocking the display, the watch thread swaps them
+    ciMonFont* pBig;
+    ciMonFont* pSmall;
+    if(!LoadFonts(szFont, nBigFontHeight, nSmallFontHeight, pBig, pSmall))
+      return false;
+
+    if(!Running()) {
+      UseFonts(pBig, pSmall, bTwoLineMode);
       m_bUpdateScreen = true;
       return true;
     }
+
+    ciMonFont* pOldBig = NULL;
+    ciMonFont* pOldSmall = NULL;
+    {
+      cMutexLooker m(mutex);
+      if(m_Shared.bFonts) { // not yet used, replace them
+        pOldBig = m_Shared.pFontBig;
+        pOldSmall = m_Shared.pFontSmall;
+      }
+      m_Shared.pFontBig = pBig;
+      m_Shared.pFontSmall = pSmall;
+      m_Shared.bTwoLineMode = bTwoLineMode;
+      m_Shared.bFonts = true;
+      Wakeup();
+    }
+    theFontManager.Release(pOldBig);
+    theFontManager.Release(pOldSmall);
+    return true;
+}
+
+/**
+ * Write metrics periodically to this file, NULL to disable.
+ */
+void ciMonWatch::SetMetricsFile(const char *szFileName) {
+  cMutexLooker m(mutex);
+  m_sMetricsFile = szFileName;
+  m_Shared.bMetrics = !isempty(szFileName);
+  Wakeup();
+}
+
+/**
+ * Run benchmark, while the watch thread is paused.
+ */
+bool ciMonWatch::Benchmark(int nFrames, ciMonBenchmark& result) {
+  {
+    // pause the watch thread, it acknowledges at start of its next pass
+    cMutexLooker m(mutex);
+    m_Shared.bPause = true;
+    Wakeup();
+    while(Active() && !m_bPaused)
+      m_PauseAck.TimedWait(mutex, 100);
+  }
+  bool bOk = ciMonLCD::Benchmark(nFrames, result);
+  cMutexLooker m(mutex);
+  m_Shared.bPause = false;
+  m_Shared.bUpdateScreen = true; // restore screen contents
+  Wakeup();
+  return bOk;
+}
+
+/**
+ * Play a scripted session, like a user would do, see session.c.
+ * \return false, if the watch thread isn't running.
+ */
+bool ciMonWatch::Session(int nCycles, ciMonSessionResult& result) {
+  if(!Active())
     return false;
+  ciMonSession session(*this);
+  session.Run(nCycles, result);
+  return true;
 }
 
 eIconState ciMonWatch::ForceIcon(unsigned int nIcon, eIconState nState) {
+  cMutexLooker m(mutex);
+  Wakeup();
 
   unsigned int nIconOff = nIcon;
   if(nIconOff & eIconTopMask)
@@ -1087,25 +1358,25 @@ eIconState ciMonWatch::ForceIcon(unsigned int nIcon, eIconState nState) {
   
   switch(nState) {
     case eIconStateAuto:
-      m_nIconsForceOn   &= ~(nIconOff);
-      m_nIconsForceOff  &= ~(nIconOff);
-      m_nIconsForceMask &= ~(nIconOff);
+      m_Shared.nIconsForceOn   &= ~(nIconOff);
+      m_Shared.nIconsForceOff  &= ~(nIconOff);
+      m_Shared.nIconsForceMask &= ~(nIconOff);
       break;
     case eIconStateOn:
-      m_nIconsForceOn   |=   nIcon;
-      m_nIconsForceOff  &= ~(nIconOff);
-      m_nIconsForceMask |=   nIconOff;
+      m_Shared.nIconsForceOn   |=   nIcon;
+      m_Shared.nIconsForceOff  &= ~(nIconOff);
+      m_Shared.nIconsForceMask |=   nIconOff;
       break;
     case eIconStateOff:
-      m_nIconsForceOff  |=   nIcon;
-      m_nIconsForceOn   &= ~(nIconOff);
-      m_nIconsForceMask |=   nIconOff;
+      m_Shared.nIconsForceOff  |=   nIcon;
+      m_Shared.nIconsForceOn   &= ~(nIconOff);
+      m_Shared.nIconsForceMask |=   nIconOff;
       break;
     default:
       break;
   }
-  if(m_nIconsForceOn  & nIcon) return eIconStateOn;
-  if(m_nIconsForceOff & nIcon) return eIconStateOff;
+  if(m_Shared.nIconsForceOn  & nIcon) return eIconStateOn;
+  if(m_Shared.nIconsForceOff & nIcon) return eIconStateOff;
   return eIconStateAuto;
 }
 
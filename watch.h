@@ -17,17 +17,13 @@
 #include <vdr/thread.h>
 #include <vdr/status.h>
 #include "imon.h"
+#include "event.h"
+#include "text.h"
+#include "replay.h"
+#include "session.h"
 
-enum eWatchMode {
-    eUndefined,
-    eLiveTV,
-    eReplayNormal,
-    eReplayMusic,
-    eReplayDVD,
-    eReplayFile,
-    eReplayImage,
-    eReplayAudioCD
-};
+#define AUDIO_CHECK_INTERVAL 1000 ///< milliseconds between checks of audio track
+#define AUDIO_CHECKS         5    ///< unchanged checks, until audio track is settled
 
 enum eReplayState {
     eReplayNone,
@@ -41,32 +37,6 @@ enum eReplayState {
   	eReplayBackward3
 };
 
-enum eReplayMode {
-    eReplayModeNormal,
-  	eReplayModeShuffle,
-  	eReplayModeRepeat,
-  	eReplayModeRepeatShuffle,
-};
-
-enum eVideoMode {
-    eVideoNone,
-    eVideoMPG,
-    eVideoDivX,
-    eVideoXviD,
-    eVideoWMV
-};
-
-enum eAudioMode {
-    eAudioNone  = 0,
-    eAudioMPG   = 1 << 0,
-    eAudioAC3   = 1 << 1,
-    eAudioDTS   = 1 << 2,
-    eAudioWMA   = 1 << 3,
-    eAudioMP3   = 1 << 4,
-    eAudioOGG   = 1 << 5,
-    eAudioWAV   = 1 << 6
-};
-
 enum eIconState { 
   eIconStateQuery, 
   eIconStateOn, 
@@ -74,12 +44,65 @@ enum eIconState {
   eIconStateAuto 
 };
 
+enum eWatchJob {
+  eJobSuspend,   ///< check of suspend window, at every minute
+  eJobClock,     ///< current time, at every minute
+  eJobReplay,    ///< replay position, twice a second
+  eJobScroll,    ///< next step of scrolling text
+  eJobSpin,      ///< next frame of disc animation
+  eJobProgress,  ///< progress bar of present event grows
+  eJobMetrics,   ///< update of metrics file
+  eJobAudio,     ///< audio track of primary device, until it's settled
+  eJobCount
+};
+
+/**
+ * Deadlines of periodic jobs of the watch thread, in milliseconds of cTimeMs.
+ * The thread sleeps until the earliest one, or until a state was changed.
+ */
+class ciMonDeadlines {
+private:
+  uint64_t m_nDeadline[eJobCount]; ///< 0, if job isn't scheduled
+public:
+  ciMonDeadlines() { Clear(); }
+  void Clear() { for(int n = 0; n < eJobCount; ++n) m_nDeadline[n] = 0; }
+  void At(eWatchJob eJob, uint64_t nWhen) { m_nDeadline[eJob] = nWhen ? nWhen : 1; }
+  void Cancel(eWatchJob eJob) { m_nDeadline[eJob] = 0; }
+  bool Pending(eWatchJob eJob) const { return m_nDeadline[eJob] != 0; }
+  bool Due(eWatchJob eJob, uint64_t nNow) const { return m_nDeadline[eJob] && nNow >= m_nDeadline[eJob]; }
+  bool DueOnly(eWatchJob eJob, uint64_t nNow) const;
+  void Next(eWatchJob eJob, int nPeriod, uint64_t nNow);
+  int Delay(uint64_t nNow, int nMax) const;
+};
+
+/**
+ * State, which is changed by other threads (SVDRP, setup menu). It's guarded
+ * by the mutex and copied by the watch thread at start of each pass, all
+ * other state belongs to the watch thread.
+ */
+struct ciMonWatchShared {
+  unsigned int nIconsForceOn;
+  unsigned int nIconsForceOff;
+  unsigned int nIconsForceMask;
+  bool         bUpdateScreen;  ///< redraw of whole screen was requested
+  bool         bFonts;         ///< fonts are waiting to be used by watch thread
+  bool         bPause;         ///< watch thread must not write, see Benchmark()
+  bool         bMetrics;       ///< a metrics file is set, see SetMetricsFile()
+  bool         bTwoLineMode;
+  ciMonFont*   pFontBig;
+  ciMonFont*   pFontSmall;
+};
 
 class ciMonWatch
  : public  ciMonLCD
  , protected cThread {
 private:
   cMutex mutex;
+  cCondWait m_Wakeup;
+  cCondVar  m_PauseAck;         ///< signaled, if the watch thread changed m_bPaused
+  bool      m_bPaused;          ///< guarded by mutex, watch thread has acknowledged bPause
+  ciMonEventQueue m_Events;     ///< status changes, applied by watch thread
+  mutable cMutex m_ControlMutex; ///< guards m_pControl, never held during output
 
   volatile bool m_bShutdown;
 
@@ -94,9 +117,7 @@ private:
 
   int   m_nCardIsRecording[MAXDEVICES];
 
-  unsigned int m_nIconsForceOn;
-  unsigned int m_nIconsForceOff;
-  unsigned int m_nIconsForceMask;
+  ciMonWatchShared m_Shared;    ///< guarded by mutex
 
 #if APIVERSNUM >= 20302
   const cControl *m_pControl;
@@ -105,37 +126,79 @@ private:
 #endif
 
   tChannelID  chID;
+#if APIVERSNUM >= 20302
+  cStateKey   m_SchedulesKey;        ///< schedules are looked up only after changes
+#else
+  time_t      m_tSchedulesModified;  ///< schedules are looked up only after changes
+#endif
+  time_t      m_tProgramRetry;       ///< next lookup, if the present event is over
   tEventID    chEventID;
   time_t      chPresentTime;
   time_t      chFollowingTime;
-  cString*    chName;
-  cString*    chPresentTitle;
-  cString*    chPresentShortTitle;
+  ciMonText   chName;
+  ciMonText   chPresentTitle;
+  ciMonText   chPresentShortTitle;
 
   int   m_nLastVolume;
   bool  m_bVolumeMute;
 
-  cString*    osdTitle;
-  cString*    osdItem;
-  cString*    osdMessage;
+  eTrackType m_eAudioTrackType;
+  int        m_nAudioChannel;
+  int        m_nAudioChecks;    ///< checks of audio track left, until it's settled
 
-  eReplayMode m_eReplayMode;
-  cString* replayTitle;
-  cString* replayTitleLast;
-  cString* replayTime;
+  ciMonText   osdTitle;
+  ciMonText   osdItem;
+  ciMonText   osdMessage;
 
-  time_t   tsCurrentLast;
-  cString* currentTime;
+  eReplayMode m_eReplayMode;
+  ciMonText replayTitle;
+  ciMonText replayTitleLast;
+  ciMonReplayClassifier m_Classifier;  ///< used only by watch thread
+  ciMonText replayTime;
+  int       m_nFrameRate;      ///< frames per 1000 seconds of replay, 0 if unknown
+  uint64_t  m_nFrameRateNext;  ///< next query of frame rate
+
+  eReplayState m_eReplayState;     ///< mode of player at last query
+  uint64_t     m_nReplayModeNext;  ///< next query of mode
+  uint64_t     m_nReplaySyncNext;  ///< next query of position, while it's predicted
+  bool         m_bReplayIndex;     ///< position of player is known
+  int          m_nReplayIndex;     ///< position at m_nReplayIndexTime
+  int          m_nReplayTotal;
+  uint64_t     m_nReplayIndexTime;
+  const ciMonText* m_pHeader;  ///< header of last full redraw, NULL if none
+  int       m_nHeaderWidth;
+  int       m_nHeaderRight;    ///< end of space for header, begin of clock
+
+  time_t    tsCurrentLast;
+  ciMonText currentTime;
+
+  cString  m_sMetricsFile;  ///< guarded by mutex, watch thread uses m_Shared.bMetrics
 protected:
   virtual void Action(void);
+  void Wakeup();
+  bool Paused();
+  int NextProgressStep() const;
+  bool CheckAudioTrack();
+  void WriteMetrics();
   bool Program();
   bool Replay();
-  bool RenderScreen(bool bRedraw);
-  eReplayState ReplayMode() const;
-  bool ReplayPosition(int &current, int &total, double& dFrameRate) const;
+  bool ProcessEvents();
+  void ReplayingEvent(const void *pControl, const char *szName, bool bOn);
+  void RecordingEvent(unsigned int nCardIndex, bool bOn);
+  void ChannelEvent(int nChannelNumber);
+  void ResyncEvent();
+  void VolumeEvent(int nVolume, bool bAbsolute);
+  void AudioTrackEvent(eTrackType eType, int nChannel);
+  void OsdClearEvent();
+  void OsdTextEvent(ciMonText& text, const char *sz);
+  bool RenderScreen(bool bRedraw, bool bScrollStep, int nHeaderFrom);
+  eReplayState ReplayMode() const { return m_eReplayState; }
+  eReplayState QueryReplayMode() const;
+  void ReplaySync(uint64_t nNow, bool bForce);
+  bool ReplayPosition(int &current, int &total) const;
   bool CurrentTime();
-  bool ReplayTime(int& current, int& total);
-  const char * FormatReplayTime(int current, int total, double dFrameRate) const;
+  int ReplayTime(int& current, int& total);
+  void FormatReplayTime(char *sz, size_t nSize, int current, int total) const;
 public:
   ciMonWatch();
   virtual ~ciMonWatch();
@@ -147,6 +210,7 @@ public:
   void Recording(const cDevice *pDevice, const char *szName, const char *szFileName, bool bOn);
   void Channel(int nChannelNumber);
   void Volume(int nVolume, bool bAbsolute);
+  void AudioTrack(eTrackType eType, int nChannel);
 
   void OsdClear();
   void OsdTitle(const char *sz);
@@ -156,6 +220,9 @@ public:
   virtual bool SetFont(const char *szFont, bool bTwoLineMode, int nBigFontHeight, int nSmallFontHeight);
 
   eIconState ForceIcon(unsigned int nIcon, eIconState nState);
+  bool Benchmark(int nFrames, ciMonBenchmark& result);
+  bool Session(int nCycles, ciMonSessionResult& result);
+  void SetMetricsFile(const char *szFileName);
 };
 
 #endif
@@ -0,0 +1,331 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <vdr/tools.h>
+
+#include "writer.h"
+#include "stats.h"
+
+ciMonWriter::ciMonWriter()
+: cThread("iMonLCD: writer thread")
+{
+  fd = -1;
+  m_bShutdown = false;
+  m_bBusy = false;
+  m_bError = false;
+  queueHead = 0;
+  queueCount = 0;
+  frameDirty = 0;
+  frameFailed = 0;
+  memset(icons, 0, sizeof(icons));
+  iconsDirty = false;
+  linesDirty = 0;
+  memset(contrast, 0, sizeof(contrast));
+  contrastDirty = false;
+  memset(&stats, 0, sizeof(stats));
+}
+
+ciMonWriter::~ciMonWriter()
+{
+  Stop();
+}
+
+/**
+ * Start the writer thread for a opened device.
+ */
+bool ciMonWriter::Start(int nFd)
+{
+  Stop();
+
+  cMutexLock lock(&mutex);
+  fd = nFd;
+  m_bShutdown = false;
+  m_bError = false;
+  queueHead = 0;
+  queueCount = 0;
+  frameDirty = 0;
+  frameFailed = 0;
+  iconsDirty = false;
+  linesDirty = 0;
+  contrastDirty = false;
+  return cThread::Start();
+}
+
+/**
+ * Write all pending data and stop the writer thread.
+ */
+void ciMonWriter::Stop()
+{
+  if(Active()) {
+    mutex.Lock();
+    m_bShutdown = true;
+    cond.Broadcast();
+    mutex.Unlock();
+    Cancel(3);
+  }
+  cMutexLock lock(&mutex);
+  fd = -1;
+}
+
+/**
+ * Wait until all posted data are written.
+ * \return false, if any write failed since last call.
+ */
+bool ciMonWriter::Flush()
+{
+  cMutexLock lock(&mutex);
+  while(Active() && (m_bBusy || Pending())) {
+    drained.Wait(mutex);
+  }
+  bool bOk = !m_bError;
+  m_bError = false;
+  return bOk;
+}
+
+/**
+ * Check for lost contents of display memory, the caller must post them again.
+ * \return true, if any write of a register failed since last call.
+ */
+bool ciMonWriter::FrameFailed()
+{
+  cMutexLock lock(&mutex);
+  bool bFailed = frameFailed != 0;
+  frameFailed = 0;
+  return bFailed;
+}
+
+/**
+ * Queue a command, which must be written in order.
+ * \param packet  Encoded command, see ciMonEncoder.
+ */
+bool ciMonWriter::Command(const uchar* packet)
+{
+  cMutexLock lock(&mutex);
+  if(fd < 0 || !Active())
+    return false;
+  bool bOk = Spill() && Enqueue(packet);
+  cond.Broadcast();
+  return bOk;
+}
+
+/**
+ * Post the latest contents of a display memory register.
+ * \param nPacket  Number of packet (0 .. IMON_FRAME_PACKETS - 1)
+ * \param packet   7 bytes of display data, followed by the register byte.
+ */
+void ciMonWriter::Packet(int nPacket, const uchar* packet)
+{
+  if(nPacket < 0 || nPacket >= IMON_FRAME_PACKETS)
+    return;
+  cMutexLock lock(&mutex);
+  memcpy(frame[nPacket], packet, IMON_PACKET_SIZE);
+  frameDirty |= (1 << nPacket);
+  cond.Broadcast();
+}
+
+/**
+ * Post the latest icon command.
+ */
+void ciMonWriter::Icons(const uchar* packet)
+{
+  cMutexLock lock(&mutex);
+  memcpy(icons, packet, IMON_PACKET_SIZE);
+  iconsDirty = true;
+  cond.Broadcast();
+}
+
+/**
+ * Post the latest commands for the built-in progress-bars.
+ */
+void ciMonWriter::Lines(const uchar* line0, const uchar* line1, const uchar* line2)
+{
+  cMutexLock lock(&mutex);
+  memcpy(lines[0], line0, IMON_PACKET_SIZE);
+  memcpy(lines[1], line1, IMON_PACKET_SIZE);
+  memcpy(lines[2], line2, IMON_PACKET_SIZE);
+  linesDirty = 0x7;
+  cond.Broadcast();
+}
+
+/**
+ * Post the latest contrast command.
+ */
+void ciMonWriter::Contrast(const uchar* packet)
+{
+  cMutexLock lock(&mutex);
+  memcpy(contrast, packet, IMON_PACKET_SIZE);
+  contrastDirty = true;
+  cond.Broadcast();
+}
+
+/**
+ * Get counters of written packets.
+ * \param bReset  Start new counting.
+ */
+void ciMonWriter::Statistics(ciMonWriterStats& result, bool bReset)
+{
+  cMutexLock lock(&mutex);
+  result = stats;
+  if(bReset)
+    memset(&stats, 0, sizeof(stats));
+}
+
+/**
+ * Monotonic time in microseconds.
+ */
+uint64_t ciMonWriter::NowUs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// caller must hold the mutex
+bool ciMonWriter::Pending() const
+{
+  return queueCount
+      || frameDirty
+      || iconsDirty
+      || linesDirty
+      || contrastDirty;
+}
+
+// caller must hold the mutex, nFrame get the register of display memory or -1
+bool ciMonWriter::PopSlot(uchar* packet, int& nFrame)
+{
+  nFrame = -1;
+  if(contrastDirty) {
+    memcpy(packet, contrast, IMON_PACKET_SIZE);
+    contrastDirty = false;
+    return true;
+  }
+  if(iconsDirty) {
+    memcpy(packet, icons, IMON_PACKET_SIZE);
+    iconsDirty = false;
+    return true;
+  }
+  for(int n = 0; linesDirty && n < 3; ++n) {
+    if(linesDirty & (1 << n)) {
+      memcpy(packet, lines[n], IMON_PACKET_SIZE);
+      linesDirty &= ~(1 << n);
+      return true;
+    }
+  }
+  for(int n = 0; frameDirty && n < IMON_FRAME_PACKETS; ++n) {
+    if(frameDirty & (1 << n)) {
+      memcpy(packet, frame[n], IMON_PACKET_SIZE);
+      frameDirty &= ~(1 << n);
+      nFrame = n;
+      return true;
+    }
+  }
+  return false;
+}
+
+// caller must hold the mutex, wait until queue has free space
+// return false, if the packet was dropped, because the writer thread has ended
+bool ciMonWriter::Enqueue(const uchar* packet, int nFrame)
+{
+  while(queueCount >= IMON_QUEUE_SIZE && Active()) {
+    drained.Wait(mutex);
+  }
+  if(queueCount >= IMON_QUEUE_SIZE)
+    return false;
+  int n = (queueHead + queueCount) % IMON_QUEUE_SIZE;
+  memcpy(queue[n], packet, IMON_PACKET_SIZE);
+  queueFrame[n] = nFrame;
+  ++queueCount;
+  return true;
+}
+
+// caller must hold the mutex, move all pending slots into ordered queue
+bool ciMonWriter::Spill()
+{
+  uchar packet[IMON_PACKET_SIZE];
+  int nFrame;
+  while(PopSlot(packet, nFrame)) {
+    if(!Enqueue(packet, nFrame))
+      return false;
+  }
+  return true;
+}
+
+bool ciMonWriter::Write(const uchar* packet)
+{
+  int err = write(fd, packet, IMON_PACKET_SIZE);
+  if (err <= 0) {
+    esyslog("iMonLCD: error writing to file descriptor: %d (%s)", err, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void ciMonWriter::Action(void)
+{
+  uchar packet[IMON_PACKET_SIZE];
+  int nFrame;
+
+  mutex.Lock();
+  for (;;) {
+    while(!m_bShutdown && !Pending()) {
+      cond.Wait(mutex);
+    }
+    if(queueCount) {
+      memcpy(packet, queue[queueHead], IMON_PACKET_SIZE);
+      nFrame = queueFrame[queueHead];
+      queueHead = (queueHead + 1) % IMON_QUEUE_SIZE;
+      --queueCount;
+    } else if(!PopSlot(packet, nFrame)) {
+      break; // shutdown and all data are written
+    }
+    m_bBusy = true;
+    drained.Broadcast();
+    mutex.Unlock();
+
+    uint64_t nStart = NowUs();
+    bool bOk = Write(packet);
+    uint64_t nLatency = NowUs() - nStart;
+    cCondWait::SleepMs(2);
+
+    mutex.Lock();
+    m_bBusy = false;
+    ++stats.writes;
+    stats.latencySum += nLatency;
+    if(nLatency > stats.latencyMax)
+      stats.latencyMax = nLatency;
+    if(bOk) {
+      stats.bytes += IMON_PACKET_SIZE;
+      ciMonStats::Add(theStats.packetsWritten);
+      ciMonStats::Add(theStats.bytesWritten, IMON_PACKET_SIZE);
+    } else {
+      ++stats.errors;
+      m_bError = true;
+      // the register keeps old contents, until it's written again
+      if(nFrame >= 0)
+        frameFailed |= (1 << nFrame);
+      ciMonStats::Add(theStats.writeErrors);
+    }
+    theStats.writeLatency.Add(nLatency);
+    if(!Pending())
+      drained.Broadcast();
+  }
+  m_bBusy = false;
+  drained.Broadcast();
+  mutex.Unlock();
+  dsyslog("iMonLCD: writer thread closed (pid=%d)", getpid());
+}
@@ -0,0 +1,99 @@
+/*
+ * iMON LCD plugin for VDR (C++)
+ *
+ * (C) 2009-2012 Andreas Brachold <vdr07 AT deltab de>
+ *
+ * This iMON LCD plugin is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, version 3 of the License.
+ *
+ * See the files README and COPYING for details.
+ *
+ */
+
+#ifndef __IMON_WRITER_H
+#define __IMON_WRITER_H
+
+#include <stdint.h>
+#include <vdr/thread.h>
+
+#define IMON_PACKET_SIZE   8     /**< the kernel module expects 8 byte chunks */
+#define IMON_FRAME_PACKETS 28    /**< display memory register 0x20..0x3b */
+#define IMON_QUEUE_SIZE    64    /**< ordered commands, which wait for write */
+
+/**
+ * Counters of written packets, used by benchmark.
+ */
+struct ciMonWriterStats {
+  unsigned int writes;
+  unsigned int errors;
+  uint64_t     bytes;
+  uint64_t     latencySum;  ///< time spent in write(), microseconds
+  uint64_t     latencyMax;
+};
+
+/**
+ * Writes all data to the display from its own thread.
+ *
+ * Display contents, icons, progress bars and contrast are stored in slots,
+ * which hold only the latest state. A pending slot is overwritten by newer
+ * data, so a burst of changes collapse into a single write.
+ * Other commands (init, shutdown, clock) are written in order. Pending slots
+ * are moved into this queue before such a command, to keep the sequence.
+ */
+class ciMonWriter : protected cThread {
+private:
+  cMutex   mutex;
+  cCondVar cond;     ///< signaled if new data are posted
+  cCondVar drained;  ///< signaled if the queue get space or all data are written
+
+  int      fd;
+  bool     m_bShutdown;
+  bool     m_bBusy;
+  bool     m_bError;
+
+  uchar    queue[IMON_QUEUE_SIZE][IMON_PACKET_SIZE];
+  int      queueFrame[IMON_QUEUE_SIZE];  ///< register of spilled slot or -1
+  int      queueHead;
+  int      queueCount;
+
+  uchar    frame[IMON_FRAME_PACKETS][IMON_PACKET_SIZE];
+  uint32_t frameDirty;
+  uint32_t frameFailed;  ///< registers, which write failed since last FrameFailed()
+  uchar    icons[IMON_PACKET_SIZE];
+  bool     iconsDirty;
+  uchar    lines[3][IMON_PACKET_SIZE];
+  int      linesDirty;
+  uchar    contrast[IMON_PACKET_SIZE];
+  bool     contrastDirty;
+
+  ciMonWriterStats stats;
+
+  bool Pending() const;
+  bool PopSlot(uchar* packet, int& nFrame);
+  bool Enqueue(const uchar* packet, int nFrame = -1);
+  bool Spill();
+  bool Write(const uchar* packet);
+protected:
+  virtual void Action(void);
+public:
+  ciMonWriter();
+  virtual ~ciMonWriter();
+
+  bool Start(int nFd);
+  void Stop();
+  bool Flush();
+  bool FrameFailed();
+
+  bool Command(const uchar* packet);
+  void Packet(int nPacket, const uchar* packet);
+  void Icons(const uchar* packet);
+  void Lines(const uchar* line0, const uchar* line1, const uchar* line2);
+  void Contrast(const uchar* packet);
+
+  void Statistics(ciMonWriterStats& result, bool bReset);
+
+  static uint64_t NowUs();
+};
+
+#endif